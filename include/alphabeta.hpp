@@ -1,5 +1,6 @@
 #ifndef ALPHABETA_HPP
 #define ALPHABETA_HPP
+#include <atomic>
 #include <chrono>
 #include <cstdint>
 #include <vector>
@@ -10,21 +11,60 @@
 #define BASE_BETA 262144
 #define MAX_SCORE 524288
 
+// Maximum search depth, the evaluators keep one state per ply
+#define MAX_PLY 64
+
 using std::chrono::steady_clock;
 using std::chrono::time_point;
 
 namespace PijersiEngine::AlphaBeta
 {
-    extern int64_t predictedScore;
+    // Score of the last move found by ponderAlphaBeta in the calling thread
+    extern thread_local int64_t predictedScore;
+    // Number of nodes visited by ponderAlphaBeta since the last reset, the counters are shared by the concurrent searches
+    extern std::atomic<uint64_t> nodeCount;
+    // Evaluation cache lookups since the last reset
+    extern std::atomic<uint64_t> evalCacheHits;
+    extern std::atomic<uint64_t> evalCacheMisses;
+
+    /* Incremental table evaluation (Evaluation::table), the default evaluator of the search.
+    An evaluator is set once on the root position with init, then follows the search with play and unplay.
+    evaluate and evaluateMove return scores from the point of view of the current player.
+    cached tells if the leaf evaluations go through Hash::evalCache, which only pays off for evaluators slower than hashing the board.
+    NNUE::Evaluator implements the same interface. */
+    struct TableEvaluator
+    {
+        static constexpr bool cached = false;
+
+        // Score of the position (from White's point of view) and of each of its cells
+        int64_t score;
+        int64_t pieceScores[45];
+
+        // Cell scores replaced by the moves of each ply (start, mid, end), and the moves
+        int64_t replacedScores[MAX_PLY][3];
+        int64_t previousScores[MAX_PLY];
+        uint64_t moves[MAX_PLY];
+        size_t ply = 0;
+
+        void init(const uint8_t cells[45]);
+        void play(uint64_t move, const uint8_t previousCells[45], const uint8_t cells[45]);
+        void unplay();
+        int64_t evaluate(uint8_t currentPlayer) const;
+        int64_t evaluateMove(uint64_t move, const uint8_t cells[45], uint8_t currentPlayer);
+    };
 
     uint64_t ponderAlphaBeta(int recursionDepth, bool random, const uint8_t cells[45], uint8_t currentPlayer, uint64_t principalVariation, time_point<steady_clock> finishTime = time_point<steady_clock>::max(), int64_t *lastScores = nullptr);
+    template <class Evaluator>
+    uint64_t _ponderAlphaBeta(int recursionDepth, bool random, const uint8_t cells[45], uint8_t currentPlayer, uint64_t principalVariation, time_point<steady_clock> finishTime, int64_t *lastScores);
     inline int64_t evaluatePiece(uint8_t piece, size_t i);
     int64_t evaluatePosition(const uint8_t cells[45]);
     int64_t evaluatePosition(const uint8_t cells[45], int64_t pieceScores[45]);
     int64_t updatePositionEval(int64_t previousScore, uint8_t previousPieceScores, uint8_t previousCells[45], uint8_t cells[45]);
     inline int64_t evaluateMoveTerminal(uint64_t move, const uint8_t cells[45], uint8_t currentPlayer, int64_t previousScore, int64_t previousPieceScores[45]);
-    int64_t evaluateMove(uint64_t move, int recursionDepth, int64_t alpha, int64_t beta, const uint8_t cells[45], uint8_t currentPlayer, time_point<steady_clock> finishTime, bool allowNullMove);
-    int64_t evaluateMoveParallel(uint64_t move, int recursionDepth, int64_t alpha, int64_t beta, const uint8_t cells[45], uint8_t currentPlayer, time_point<steady_clock> finishTime, bool allowNullMove);
+    template <class Evaluator>
+    int64_t evaluateMove(uint64_t move, int recursionDepth, int64_t alpha, int64_t beta, const uint8_t cells[45], uint8_t currentPlayer, Evaluator &evaluator, time_point<steady_clock> finishTime, bool allowNullMove);
+    template <class Evaluator>
+    int64_t evaluateMoveParallel(uint64_t move, int recursionDepth, int64_t alpha, int64_t beta, const uint8_t cells[45], uint8_t currentPlayer, Evaluator &evaluator, time_point<steady_clock> finishTime, bool allowNullMove);
 
     // Deprecated
     int64_t updatePieceEval(int64_t previousPieceScore, uint8_t piece, size_t i);
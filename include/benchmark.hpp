@@ -0,0 +1,26 @@
+#ifndef BENCHMARK_HPP
+#define BENCHMARK_HPP
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define BENCH_PERFT_DEPTH 3
+#define BENCH_SEARCH_DEPTH 4
+
+namespace PijersiEngine::Benchmark
+{
+    // Fixed suite of PSN positions: opening, middlegame, stack-heavy and endgame
+    extern const std::vector<std::string> positions;
+
+    struct Result
+    {
+        uint64_t perftNodes = 0;
+        uint64_t searchNodes = 0;
+        uint64_t signature = 0;
+        uint64_t durationMilliseconds = 0;
+    };
+
+    Result run(int perftDepth = BENCH_PERFT_DEPTH, int searchDepth = BENCH_SEARCH_DEPTH, bool verbose = true);
+}
+
+#endif
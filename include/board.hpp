@@ -36,8 +36,10 @@ namespace PijersiEngine
         uint64_t searchRandom();
         uint64_t playRandom();
 
-        // uint64_t playMCTS(int seconds = 10, int simulationsPerRollout = 3);
-        // uint64_t ponderMCTS(int seconds, int simulationsPerRollout);
+        // Monte Carlo tree search, limited by time and/or by visits of the root
+
+        uint64_t searchMCTS(uint64_t searchTimeMilliseconds = 10000, uint64_t maxNodes = UINT64_MAX, int simulationsPerRollout = 1);
+        uint64_t playMCTS(uint64_t searchTimeMilliseconds = 10000, uint64_t maxNodes = UINT64_MAX, int simulationsPerRollout = 1);
         
         std::string advice(int recursionDepth, bool random);
         bool isMoveLegal(uint64_t move);
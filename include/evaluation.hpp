@@ -0,0 +1,44 @@
+#ifndef EVALUATION_HPP
+#define EVALUATION_HPP
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Number of values of Parameters
+#define N_EVAL_PARAMETERS 9
+// Multiplier of the line scores on the goal line, a piece there wins the game
+#define EVAL_GOAL_MULTIPLIER 256
+
+namespace PijersiEngine::Evaluation
+{
+    /* Parameters of the piece table, in the order of the tuners:
+    values[0] to values[6] are the scores of a non-Wise piece on each line counted from its own side (values[6] is the goal line),
+    values[7] is the stack bonus and values[8] the score of a Wise.
+    A stack scores twice its top piece plus the stack bonus. The defaults build Lookup::pieceScores. */
+    struct Parameters
+    {
+        float values[N_EVAL_PARAMETERS] = {63, 100, 110, 115, 130, 135, 150, -10, 70};
+
+        float pieceScore(uint8_t piece, size_t index) const;
+        void fillTable(int64_t table[1575]) const;
+        bool parse(const std::string &text);
+        std::string toString() const;
+    };
+
+    /* Table used by the evaluation, index = pieceIndex * 45 + cellIndex (see Lookup::pieceScores).
+    It is a copy of Lookup::pieceScores unless it is replaced at runtime. */
+    extern int64_t pieceScores[1575];
+
+    /* Table used by the evaluation in the current thread, pieceScores unless the thread has its own (setThreadTable).
+    Threads that search with different parameters, like the games of weigth_optim, must search with a single thread. */
+    extern thread_local constinit const int64_t *table;
+
+    void resetTable();
+    void setParameters(const Parameters &parameters);
+    void setTable(const int64_t newTable[1575]);
+    void setThreadTable(const int64_t *threadTable);
+    bool loadFile(const std::string &fileName);
+    bool saveTable(const std::string &fileName, const int64_t table[1575]);
+}
+
+#endif
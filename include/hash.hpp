@@ -1,16 +1,70 @@
 #ifndef HASH_HPP
 #define HASH_HPP
 
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
 #include <list>
+#include <memory>
 #include <unordered_map>
 #include <assert.h>
 
 namespace PijersiEngine::Hash
 {
     extern uint64_t pieceHashKeys[1575];
+    extern uint64_t playerHashKey;
     void hashInit();
     uint64_t hash(uint8_t cells[45], int recursionDepth);
+    uint64_t hashPiece(uint8_t piece, int index);
+    uint64_t hashPosition(const uint8_t cells[45], uint8_t currentPlayer);
+    uint64_t updateHash(uint64_t key, uint64_t move, const uint8_t previousCells[45], const uint8_t cells[45]);
+
+    /* Lock-free cache of position evaluations, shared by the search threads.
+    Each entry stores the key xored with the score, so an entry torn by concurrent writes fails the key check instead of returning a wrong score.
+    Entries are overwritten on index collisions. */
+    class EvalCache
+    {
+    private:
+        struct Entry
+        {
+            std::atomic<uint64_t> check;
+            std::atomic<int64_t> score;
+        };
+        std::unique_ptr<Entry[]> entries;
+        size_t nEntries = 0;
+        size_t sizeMegabytes = 0;
+
+    public:
+        void resize(size_t newSizeMegabytes);
+        void clear();
+        bool enabled() const
+        {
+            return nEntries > 0;
+        }
+
+        // Returns true and sets score if the position is in the cache
+        bool probe(uint64_t key, int64_t &score) const
+        {
+            const Entry &entry = entries[key & (nEntries - 1)];
+            int64_t entryScore = entry.score.load(std::memory_order_relaxed);
+            uint64_t check = entry.check.load(std::memory_order_relaxed);
+            if ((check ^ (uint64_t)entryScore) != key)
+            {
+                return false;
+            }
+            score = entryScore;
+            return true;
+        }
+
+        void store(uint64_t key, int64_t score)
+        {
+            Entry &entry = entries[key & (nEntries - 1)];
+            entry.check.store(key ^ (uint64_t)score, std::memory_order_relaxed);
+            entry.score.store(score, std::memory_order_relaxed);
+        }
+    };
+
+    extern EvalCache evalCache;
 
     // StackOverflow
     template <class KEY_T, class VAL_T> class LRUCache{
@@ -26,7 +26,14 @@
 #define TYPE_WISE 0b1100U
 
 
+// Cells of the goal rows as bitmasks (bit n is cell n): row 0 for White, row 6 for Black
+#define WHITE_GOAL_MASK 0x000000000000003FULL
+#define BLACK_GOAL_MASK 0x00001F8000000000ULL
+// Lowest bit of the 6 bytes of a goal row loaded as a 64-bit word
+#define GOAL_ROW_BYTES 0x0000010101010101ULL
+
 #define NULL_MOVE 0x00FFFFFFU
+#define COMPACT_NULL_MOVE 0xFFFFU
 #define NULL_ACTION 0xFFU
 #define MAX_PLAYER_MOVES 512
 
@@ -58,13 +65,20 @@ namespace PijersiEngine::Logic
     
     void play(uint64_t move, uint8_t cells[45]);
     void unplay(uint64_t move, uint8_t cells[45]);
+    uint64_t attachPieces(uint64_t move, const uint8_t cells[45]);
+    uint16_t compressMove(uint64_t move);
+    uint64_t decompressMove(uint16_t moveId);
     void playManual(uint64_t move, uint8_t *cells);
     uint64_t searchRandom(const uint8_t cells[45], uint8_t currentPlayer);
     uint64_t playRandom(uint8_t cells[45], uint8_t currentPlayer);
+    uint64_t sampleRandomMove(const uint8_t cells[45], uint8_t currentPlayer);
     
+    constexpr uint64_t goalMasks[2] = {WHITE_GOAL_MASK, BLACK_GOAL_MASK};
+
     bool isPositionWin(const uint8_t cells[45]);
-    bool isMoveWin(uint64_t move, const uint8_t cells[45]);
+    inline bool isMoveWin(uint64_t move, const uint8_t cells[45]);
     uint8_t getWinningPlayer(const uint8_t cells[45]);
+    bool hasWinningMove(uint8_t player, const uint8_t cells[45]);
     
     std::array<uint64_t, MAX_PLAYER_MOVES> availablePlayerMoves(const uint8_t player, const uint8_t cells[45]);
     
@@ -76,6 +90,15 @@ namespace PijersiEngine::Logic
     inline bool isUnstackValid(uint8_t movingPiece, uint64_t indexEnd, const uint8_t cells[45]);
 
     void countMoves(uint8_t currentPlayer, const uint8_t cells[45], size_t countWhite[45], size_t countBlack[45]);
+    uint64_t pieceMobility(uint64_t indexStart, const uint8_t cells[45], uint64_t &reach);
+
+    // Returns true if the move leads to a win: a non-Wise piece reaches the opposing goal row
+    inline bool isMoveWin(uint64_t move, const uint8_t cells[45])
+    {
+        uint8_t movingPiece = cells[move & INDEX_MASK];
+        uint64_t indexEnd = (move >> (2 * INDEX_WIDTH)) & INDEX_MASK;
+        return ((movingPiece & TYPE_MASK) != TYPE_WISE) && ((goalMasks[(movingPiece & COLOUR_MASK) >> 1] >> indexEnd) & 1);
+    }
 }
 
 #endif
\ No newline at end of file
@@ -1,10 +1,19 @@
 #ifndef LOOKUP_HPP
 #define LOOKUP_HPP
 
+#include <array>
 #include <cstdint>
 #include <cstdlib>
 #include <vector>
 
+#include <logic.hpp>
+
+// Flags of the piece interaction table
+#define INTERACTION_MOVE 0b0001U
+#define INTERACTION_STACK 0b0010U
+#define INTERACTION_UNSTACK 0b0100U
+#define INTERACTION_TAKE 0b1000U
+
 using std::vector;
 
 namespace PijersiEngine::Lookup
@@ -373,6 +382,162 @@ namespace PijersiEngine::Lookup
         29
     };
 
+    // Generates the piece interaction table, see pieceInteractions
+    constexpr std::array<uint8_t, 4096> _generatePieceInteractions()
+    {
+        std::array<uint8_t, 4096> interactions{};
+        for (uint8_t movingPiece = 0; movingPiece < 16; movingPiece++)
+        {
+            uint8_t movingType = movingPiece & TYPE_MASK;
+            for (size_t target = 0; target < 256; target++)
+            {
+                uint8_t targetType = target & TYPE_MASK;
+                bool sameColour = (target & COLOUR_MASK) == (movingPiece & COLOUR_MASK);
+                // Scissors > Paper, Paper > Rock, Rock > Scissors
+                bool canTake = (movingType == TYPE_SCISSORS && targetType == TYPE_PAPER) || (movingType == TYPE_PAPER && targetType == TYPE_ROCK) || (movingType == TYPE_ROCK && targetType == TYPE_SCISSORS);
+
+                uint8_t flags = 0;
+                if (canTake)
+                {
+                    flags |= INTERACTION_TAKE;
+                }
+                // The end cell is empty, or holds an enemy piece that can be captured
+                if (target == 0 || (!sameColour && canTake))
+                {
+                    flags |= INTERACTION_MOVE | INTERACTION_UNSTACK;
+                }
+                // The end cell holds a single allied piece, and a Wise piece can only be stacked on another Wise piece
+                if (target != 0 && sameColour && target < 16 && !(movingType == TYPE_WISE && targetType != TYPE_WISE))
+                {
+                    flags |= INTERACTION_STACK;
+                }
+                interactions[(movingPiece << 8) | target] = flags;
+            }
+        }
+        return interactions;
+    }
+
+    /* Associates a moving piece and a target cell to the actions that are possible between them, index = (movingPiece & TOP_MASK) << 8 | target.
+    Only the top half of the moving piece matters, which keeps the table at 4 KB so that it stays in L1.
+    The flags are INTERACTION_MOVE, INTERACTION_STACK, INTERACTION_UNSTACK and INTERACTION_TAKE. */
+    constexpr std::array<uint8_t, 4096> pieceInteractions = _generatePieceInteractions();
+
+    // Returns whether the cell indexEnd is in the segment of indexStart in a neighbour array (neighbours or neighbours2)
+    constexpr bool _isNeighbour(const size_t table[315], size_t indexStart, size_t indexEnd)
+    {
+        for (size_t k = 7 * indexStart + 1; k < 7 * indexStart + table[7 * indexStart] + 1; k++)
+        {
+            if (table[k] == indexEnd)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /* Returns whether (indexStart, indexMid, indexEnd) can be a move on an empty board, whatever the pieces, with indexMid = 45 for NULL_ACTION.
+    Pieces move 1 cell and stacks 2 cells, and a move is made of at most 2 actions, the second one starting from indexMid. */
+    constexpr bool _isGeometricMove(size_t indexStart, size_t indexMid, size_t indexEnd)
+    {
+        // Single move or 2-range move
+        if (indexMid == 45)
+        {
+            return _isNeighbour(neighbours, indexStart, indexEnd) || _isNeighbour(neighbours2, indexStart, indexEnd);
+        }
+        // Stack only or unstack only
+        if (indexMid == indexStart)
+        {
+            return _isNeighbour(neighbours, indexStart, indexEnd);
+        }
+        // 1-range first action, then a 0/1/2-range second action
+        if (_isNeighbour(neighbours, indexStart, indexMid))
+        {
+            return indexEnd == indexStart || _isNeighbour(neighbours, indexMid, indexEnd) || _isNeighbour(neighbours2, indexMid, indexEnd);
+        }
+        // 2-range first action, then a 1-range second action
+        if (_isNeighbour(neighbours2, indexStart, indexMid))
+        {
+            return _isNeighbour(neighbours, indexMid, indexEnd);
+        }
+        return false;
+    }
+
+    // Returns the number of geometric moves, see moveIds
+    constexpr size_t _countMoveIds()
+    {
+        size_t count = 0;
+        for (size_t indexStart = 0; indexStart < 45; indexStart++)
+        {
+            for (size_t indexMid = 0; indexMid < 46; indexMid++)
+            {
+                for (size_t indexEnd = 0; indexEnd < 45; indexEnd++)
+                {
+                    count += _isGeometricMove(indexStart, indexMid, indexEnd);
+                }
+            }
+        }
+        return count;
+    }
+
+    // Number of compact move ids, every id is lower than this
+    constexpr size_t moveIdCount = _countMoveIds();
+
+    // Generates the compact move id encoding table, see moveIds
+    constexpr std::array<uint16_t, 45 * 46 * 45> _generateMoveIds()
+    {
+        std::array<uint16_t, 45 * 46 * 45> ids{};
+        uint16_t id = 0;
+        for (size_t indexStart = 0; indexStart < 45; indexStart++)
+        {
+            for (size_t indexMid = 0; indexMid < 46; indexMid++)
+            {
+                for (size_t indexEnd = 0; indexEnd < 45; indexEnd++)
+                {
+                    size_t key = (indexStart * 46 + indexMid) * 45 + indexEnd;
+                    if (_isGeometricMove(indexStart, indexMid, indexEnd))
+                    {
+                        ids[key] = id;
+                        id++;
+                    }
+                    else
+                    {
+                        ids[key] = COMPACT_NULL_MOVE;
+                    }
+                }
+            }
+        }
+        return ids;
+    }
+
+    // Generates the compact move id decoding table, see moves
+    constexpr std::array<uint32_t, moveIdCount> _generateMoves()
+    {
+        std::array<uint32_t, moveIdCount> moves{};
+        size_t id = 0;
+        for (size_t indexStart = 0; indexStart < 45; indexStart++)
+        {
+            for (size_t indexMid = 0; indexMid < 46; indexMid++)
+            {
+                for (size_t indexEnd = 0; indexEnd < 45; indexEnd++)
+                {
+                    if (_isGeometricMove(indexStart, indexMid, indexEnd))
+                    {
+                        moves[id] = indexStart | ((indexMid == 45 ? NULL_ACTION : indexMid) << INDEX_WIDTH) | (indexEnd << (2 * INDEX_WIDTH));
+                        id++;
+                    }
+                }
+            }
+        }
+        return moves;
+    }
+
+    /* Associates every geometrically possible move to a dense 16-bit id, index = (indexStart * 46 + indexMid) * 45 + indexEnd, with indexMid = 45 for NULL_ACTION.
+    Impossible triples are set to COMPACT_NULL_MOVE. Ids are sorted by start cell, so the moves of a piece form a contiguous range. */
+    constexpr std::array<uint16_t, 45 * 46 * 45> moveIds = _generateMoveIds();
+
+    // Associates a compact move id to its move (indices only, without the pieces)
+    constexpr std::array<uint32_t, moveIdCount> moves = _generateMoves();
+
     // Associates a piece's type index and cell index to its score, index = pieceIndex*45 + cellIndex
     constexpr int64_t pieceScores[1575] {
         76790,
@@ -1,32 +1,227 @@
 #ifndef MCTS_HPP
 #define MCTS_HPP
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <vector>
 
+#include <logic.hpp>
+
+// Index of no node in a NodeArena
+#define NULL_NODE 0xFFFFFFFFU
+// Value of Node::firstChild while a thread allocates the children
+#define EXPANDING_NODE 0xFFFFFFFEU
+// Nodes per arena chunk (as a power of 2), a block of children never spans two chunks
+#define MCTS_CHUNK_WIDTH 16
+#define MCTS_CHUNK_SIZE (1U << MCTS_CHUNK_WIDTH)
+// Maximum number of chunks of an arena, the last one is left out so that no index reaches EXPANDING_NODE
+#define MCTS_MAX_CHUNKS ((1U << (32 - MCTS_CHUNK_WIDTH)) - 1)
+// Evaluation difference that makes a capped rollout won with a probability of 1 / (1 + e^-1)
+#define MCTS_EVALUATION_SCALE 200.f
+
+// Node scores are fixed point, a simulation adds at most MCTS_SCORE_UNIT to the score
+#define MCTS_SCORE_UNIT 1024
+// Time that the evaluator thread of PUCT waits for a full batch of leaves, in microseconds
+#define MCTS_BATCH_WAIT 1000
+// Minimum number of positions per thread when the default value function splits a batch
+#define MCTS_EVALUATION_SLICE 8
+// Number of batches that the leaf queue can hold before the selection threads wait
+#define MCTS_QUEUE_BATCHES 4
+// Interval between two info lines of the search, in milliseconds
+#define MCTS_INFO_INTERVAL 1000
+// Maximum length of the principal variation of the info lines
+#define MCTS_PV_LENGTH 16
+// Number of visits of a child for which its RAVE and UCT values weigh the same in UCT mode with RAVE
+#define MCTS_RAVE_EQUIVALENCE 1000.f
+// Exploration constant of PUCT
+#define MCTS_PUCT_EXPLORATION 1.5f
+// Maximum prior of a move, priors are stored as a fraction of it
+#define MCTS_PRIOR_MAX 0xFFFFU
+
+// Solver results of a node, for the player who played its move
+#define MCTS_UNKNOWN 0
+#define MCTS_WIN 1
+#define MCTS_LOSS 2
+
 namespace PijersiEngine::MCTS
 {
-    uint64_t ponderMCTS(int milliseconds, int simulationsPerRollout, uint8_t cells[45], uint8_t currentPlayer);
+    uint64_t ponderMCTS(std::chrono::time_point<std::chrono::steady_clock> finishTime, uint64_t maxVisits, int simulationsPerRollout, const uint8_t cells[45], uint8_t currentPlayer);
 
+    /* Leaf evaluation of PUCT, sets values[k] to the evaluation of positions[k] from the point of view of players[k] (the player to move), for k < n.
+    The values are on the scale of the network outputs (see NNUE::Network::forwardBatch, which has this signature), the default runs NNUE::network. */
+    using ValueFunction = std::function<void(const uint8_t positions[][45], const uint8_t players[], size_t n, float values[])>;
+    /* Optional policy of PUCT, sets priors[k] to the prior probability of moves[k] for k < nMoves, the priors are uniform without it. */
+    using PolicyFunction = std::function<void(const uint8_t cells[45], uint8_t player, const uint64_t moves[], size_t nMoves, float priors[])>;
+
+    extern ValueFunction valueFunction;
+    extern PolicyFunction policyFunction;
+
+    /* Node of the search tree, 24 bytes, shared by the search threads.
+    It does not store its position: the search replays the moves from the root while it descends and undoes them with Logic::unplay.
+    The children of a node are a contiguous block of the arena: firstChild to firstChild + nChildren - 1.
+    firstChild is also the expansion state: NULL_NODE before the expansion, EXPANDING_NODE while a thread allocates the children.
+    The thread that expands publishes firstChild after setting nChildren and the children, so a valid firstChild is enough to read them.
+    visits includes the virtual losses: a thread adds its rollouts to the visits of the nodes it selects, and only adds the wins after the rollouts.
+    score counts the wins of the player who played move in units of 1 / MCTS_SCORE_UNIT, so that the evaluations of PUCT can add fractions of a win.
+    result is MCTS_WIN or MCTS_LOSS once the outcome of the node is proven (MCTS-Solver). prior is the probability of move for PUCT, scaled by MCTS_PRIOR_MAX. */
     struct Node
+    {
+        std::atomic<uint32_t> firstChild = NULL_NODE;
+        uint16_t nChildren = 0;
+        // Compact move id (see Logic::compressMove)
+        uint16_t move = COMPACT_NULL_MOVE;
+
+        std::atomic<int32_t> visits = 0;
+        std::atomic<uint8_t> result = MCTS_UNKNOWN;
+        uint16_t prior = 0;
+        std::atomic<int64_t> score = 0;
+
+        void init(uint16_t newMove);
+        bool isLeaf() const;
+    };
+
+    /* All-moves-as-first statistics of the move of a node (RAVE): the simulations through its parent where the same player played
+    the same move id later on, in the tree or in the playout, and the number of them won by that player. */
+    struct RaveStats
+    {
+        std::atomic<int32_t> visits = 0;
+        std::atomic<int32_t> wins = 0;
+    };
+
+    /* Bump allocator of nodes shared by the search threads, nodes are stored in chunks of MCTS_CHUNK_SIZE nodes that stay in place while the arena grows.
+    Allocation is lock-free, except for the thread that adds a new chunk.
+    Nodes are never freed one by one: clear releases the whole tree in O(1) and keeps the chunks for the next search.
+    With RAVE, each chunk of nodes has a chunk of RaveStats with the same indices, so the nodes do not pay for them when RAVE is off. */
+    class NodeArena
+    {
+    private:
+        std::unique_ptr<std::atomic<Node *>[]> chunks;
+        std::unique_ptr<std::atomic<RaveStats *>[]> raveChunks;
+        bool rave = false;
+        std::atomic<uint32_t> used = 0;
+        // Maximum number of nodes
+        uint32_t limit = MCTS_MAX_CHUNKS * MCTS_CHUNK_SIZE;
+        std::mutex chunkMutex;
+
+    public:
+        NodeArena();
+        NodeArena(const NodeArena &) = delete;
+        NodeArena &operator=(const NodeArena &) = delete;
+        ~NodeArena();
+
+        uint32_t allocate(uint32_t nNodes);
+        void clear()
+        {
+            used = 0;
+        }
+        size_t size() const
+        {
+            return used;
+        }
+        size_t capacity() const
+        {
+            return limit;
+        }
+        void setLimit(size_t maxNodes)
+        {
+            limit = std::min(maxNodes, (size_t)MCTS_MAX_CHUNKS * MCTS_CHUNK_SIZE);
+        }
+        void release(size_t keptNodes);
+        void setRAVE(bool enabled);
+        bool hasRAVE() const
+        {
+            return rave;
+        }
+        // Returns true when the next expansion may not fit
+        bool full() const
+        {
+            return used.load(std::memory_order_relaxed) + MAX_PLAYER_MOVES > limit;
+        }
+
+        Node &operator[](uint32_t index)
+        {
+            return chunks[index >> MCTS_CHUNK_WIDTH].load(std::memory_order_relaxed)[index & (MCTS_CHUNK_SIZE - 1)];
+        }
+        // RAVE statistics of the node, only valid if hasRAVE
+        RaveStats &raveStats(uint32_t index)
+        {
+            return raveChunks[index >> MCTS_CHUNK_WIDTH].load(std::memory_order_relaxed)[index & (MCTS_CHUNK_SIZE - 1)];
+        }
+    };
+
+    // Leaf of the PUCT search waiting for its evaluation: its position and the nodes from the root
+    struct LeafRequest
     {
         uint8_t cells[45];
         uint8_t player;
-        Node *parent;
-        std::vector<Node*> children;
-        uint64_t move;
+        std::vector<uint32_t> path;
+    };
 
-        int visits = 0;
-        int score = 0;
+    /* Queue of the leaves of the PUCT search, filled by the selection threads and emptied in batches by the evaluator thread.
+    The selection threads wait when the queue is full, the evaluator waits for a full batch for at most MCTS_BATCH_WAIT microseconds. */
+    class LeafQueue
+    {
+    private:
+        std::vector<LeafRequest> requests;
+        std::mutex mutex;
+        std::condition_variable notEmpty;
+        std::condition_variable notFull;
+        size_t batchSize = 1;
+        bool closed = false;
+
+    public:
+        void open(size_t newBatchSize);
+        void close();
+        void push(const uint8_t cells[45], uint8_t player, const std::vector<uint32_t> &path);
+        bool pop(std::vector<LeafRequest> &batch);
+    };
 
-        Node(Node *newParent, const uint64_t &newMove, uint8_t newPlayer);
-        ~Node();
+    /* Search tree kept between the calls of ponderMCTS.
+    When the next search starts from a position that the tree already holds at most 2 plies below its root (our move and the reply),
+    the subtree of that position is copied to the other arena and becomes the new tree, the rest is released by clearing the old arena.
+    The tree holds at most Options::mctsMaxNodes nodes: once it is full, prune copies it without the subtrees of its least visited nodes,
+    which keep their statistics as leaves. A kept subtree that no longer fits a lowered limit is trimmed the same way when it is copied.
+    After a copy, the old arena only keeps the chunks needed to hold as many nodes as the copy, they are reused by the next copy. */
+    class Tree
+    {
+    private:
+        NodeArena arenas[2];
+        size_t current = 0;
 
-        void expand();
-        bool isLeaf();
-        bool isWin();
-        void rollout(int nSimulations);
+        uint32_t _find(const uint8_t cells[45], uint8_t player);
+        int32_t _visitThreshold(uint32_t subtreeRootIndex, size_t maxNodes);
+        void _copy(uint32_t newRootIndex, int32_t minVisits);
 
-        void update(int winCount, int visitCount);
+    public:
+        uint32_t rootIndex = NULL_NODE;
+        uint8_t rootCells[45];
+        uint8_t rootPlayer = 0;
+        // Mode of the search that built the tree, the scores of rollouts and of network values can't be mixed
+        bool puct = false;
+
+        NodeArena &arena()
+        {
+            return arenas[current];
+        }
+        Node &root()
+        {
+            return arenas[current][rootIndex];
+        }
+
+        bool setRoot(const uint8_t cells[45], uint8_t player);
+        void setLimit(size_t maxNodes);
+        void setRAVE(bool enabled);
+        void prune();
+        void clear();
     };
+
+    extern Tree tree;
 }
 
-#endif
\ No newline at end of file
+#endif
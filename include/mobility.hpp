@@ -0,0 +1,40 @@
+#ifndef MOBILITY_HPP
+#define MOBILITY_HPP
+#include <cstddef>
+#include <cstdint>
+
+namespace PijersiEngine::Mobility
+{
+    /* Attack and mobility map of a board.
+    It is built once with init, then kept up to date by play and unplay, which only recompute the pieces whose moves can depend on the cells that changed.
+    All the queries are O(1). Cell sets are bitmasks where bit n stands for cell n. */
+    struct MobilityMap
+    {
+        // Number of moves of the piece standing on each cell (0 for empty cells)
+        uint16_t pieceMoves[45];
+        // Cells where the piece standing on each cell can land with a move or an unstack
+        uint64_t pieceReach[45];
+
+        // Cells holding a piece of each colour
+        uint64_t occupied[2];
+        // Cells where a piece of each colour can land
+        uint64_t attacked[2];
+        // Number of moves available to each colour
+        uint64_t moves[2];
+
+        void init(const uint8_t cells[45]);
+        void play(uint64_t move, uint8_t cells[45]);
+        void unplay(uint64_t move, uint8_t cells[45]);
+
+        uint64_t attackedCells(uint8_t player) const;
+        uint64_t threatenedPieces(uint8_t player) const;
+        uint64_t mobility(uint8_t player) const;
+        uint16_t pieceMobility(size_t index) const;
+
+    private:
+        void _update(uint64_t changedCells, const uint8_t cells[45]);
+        void _updatePiece(size_t index, const uint8_t cells[45]);
+    };
+}
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef NN_HPP
 #define NN_HPP
 #include <cstdint>
+#include <string>
 #include <vector>
 
 #include <Eigen/Dense>
@@ -67,6 +68,7 @@ namespace PijersiEngine::NN
         void init();
         float forward(uint8_t cells[45], uint8_t currentPlayer);
         void load();
+        bool save(const std::string &fileName);
     };
 
     struct Trainer
@@ -100,6 +102,7 @@ namespace PijersiEngine::NN
         void forward();
         float loss();
         void back(float learningRate);
+        bool save(const std::string &fileName);
         // ~Trainer();
     };
 }
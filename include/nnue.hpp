@@ -0,0 +1,172 @@
+#ifndef NNUE_HPP
+#define NNUE_HPP
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include <alphabeta.hpp>
+
+// Same shapes as the NN module: 45 cells x 16 (top piece, bottom piece) one-hot features
+#define NNUE_INPUTS 720
+#define NNUE_HIDDEN_1 256
+#define NNUE_HIDDEN_2 32
+#define NNUE_HIDDEN_3 32
+
+// Converts the network output to the scale of the table evaluation
+#define NNUE_SCALE 1024
+
+// Maximum number of features that a move can add or remove (3 cells, 2 pieces per cell)
+#define NNUE_MAX_CHANGES 6
+
+/* Quantization: the first layer and the accumulators are int16 with weights scaled by NNUE_WEIGHT_SCALE.
+The activations of layers 1 and 2 are int8 clipped to [0, 127], NNUE_ACTIVATION_SCALE_N is their scale so they are clipped at 127 / scale.
+Layer 2 has int8 weights with one scale per output row. Layer 3 keeps int16 weights since its activations are too wide for int8,
+and the output layer (32 weights) stays in float. */
+#define NNUE_WEIGHT_SCALE 256
+#define NNUE_ACTIVATION_SHIFT_1 4
+#define NNUE_ACTIVATION_SCALE_1 (NNUE_WEIGHT_SCALE >> NNUE_ACTIVATION_SHIFT_1)
+#define NNUE_ACTIVATION_SCALE_2 16
+#define NNUE_ACTIVATION_MAX 127
+// Fixed point precision of the requantization multipliers
+#define NNUE_MULTIPLIER_SHIFT 16
+
+/* Weight files: a FileHeader followed by the payload at offset NNUE_FILE_ALIGNMENT.
+With NNUE_QUANTIZATION_FLOAT32, the payload is the weights then the bias of each layer, in the layout of the NN module (weights[input * outputs + output]).
+With NNUE_QUANTIZATION_INT16_INT8, the payload is an image of QuantizedLayers, which is used in place from the mapped file. */
+#define NNUE_FILE_MAGIC 0x4E4E4A50U
+#define NNUE_FILE_VERSION 1
+#define NNUE_FILE_ALIGNMENT 128
+#define NNUE_QUANTIZATION_FLOAT32 0
+#define NNUE_QUANTIZATION_INT16_INT8 1
+// Weight file of the default network, relative to the directory of the executable or to its parent (written by scripts/weights_to_nnue.py)
+#define NNUE_DEFAULT_FILE "weights/default.nnue"
+
+namespace PijersiEngine::NNUE
+{
+    struct FileHeader
+    {
+        // "PJNN"
+        uint32_t magic;
+        uint32_t version;
+        uint32_t quantization;
+        uint32_t nLayers;
+        uint32_t inputs[4];
+        uint32_t outputs[4];
+        // Quantization parameters, the file can only be used if they match the engine's
+        uint32_t weightScale;
+        uint32_t activationShift1;
+        uint32_t activationScale2;
+        uint32_t multiplierShift;
+        uint64_t payloadSize;
+        // 64-bit FNV-1a of the payload
+        uint64_t checksum;
+    };
+
+    uint64_t checksum(const uint8_t *data, size_t size);
+    bool saveFloatLayers(const std::string &fileName, const float *weights[4], const float *biases[4]);
+
+    // Read-only memory mapping of a whole file
+    struct MappedFile
+    {
+        const uint8_t *data = nullptr;
+        size_t size = 0;
+#ifdef _WIN32
+        void *fileHandle = nullptr;
+        void *mappingHandle = nullptr;
+#endif
+
+        MappedFile() = default;
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+        ~MappedFile();
+
+        bool open(const std::string &fileName);
+        void close();
+    };
+
+    // Quantized layers, in the layouts of the float layers of Network
+    struct QuantizedLayers
+    {
+        alignas(64) int16_t weights1[NNUE_INPUTS * NNUE_HIDDEN_1];
+        alignas(64) int16_t bias1[NNUE_HIDDEN_1];
+        alignas(64) int8_t weights2[NNUE_HIDDEN_2 * NNUE_HIDDEN_1];
+        alignas(64) int32_t bias2[NNUE_HIDDEN_2];
+        int32_t multipliers2[NNUE_HIDDEN_2];
+        alignas(64) int16_t weights3[NNUE_HIDDEN_3 * NNUE_HIDDEN_2];
+        alignas(64) int32_t bias3[NNUE_HIDDEN_3];
+        // Converts the int32 outputs of layer 3 back to float
+        float scales3[NNUE_HIDDEN_3];
+        alignas(64) float weights4[NNUE_HIDDEN_3];
+        float bias4;
+    };
+
+    /* Efficiently updatable version of the NN network (NNUE).
+    The first layer is a sum of the columns of the active features, so it is kept in an accumulator and updated when pieces move instead of being recomputed.
+    The other layers are small enough to be run on every evaluation. */
+    struct Network
+    {
+        // First layer, stored by feature: weights1[feature * NNUE_HIDDEN_1 + output]
+        alignas(64) float weights1[NNUE_INPUTS * NNUE_HIDDEN_1];
+        alignas(64) float bias1[NNUE_HIDDEN_1];
+        // Hidden layers, stored by output: weights[output * inputs + input]
+        alignas(64) float weights2[NNUE_HIDDEN_2 * NNUE_HIDDEN_1];
+        alignas(64) float bias2[NNUE_HIDDEN_2];
+        alignas(64) float weights3[NNUE_HIDDEN_3 * NNUE_HIDDEN_2];
+        alignas(64) float bias3[NNUE_HIDDEN_3];
+        alignas(64) float weights4[NNUE_HIDDEN_3];
+        float bias4;
+
+        // Layers used by the evaluation, they point either to ownedLayers or to the mapped weight file
+        const QuantizedLayers *layers = &ownedLayers;
+        QuantizedLayers ownedLayers;
+        MappedFile file;
+
+        // Name of the loaded weight file, the float layers are only set if the file is in float32
+        std::string fileName;
+        bool hasFloatLayers = false;
+        bool loaded = false;
+
+        bool load(const std::string &newFileName);
+        bool save(const std::string &newFileName, uint32_t quantization) const;
+        void quantize();
+        float propagate(const float accumulator[NNUE_HIDDEN_1]) const;
+        float propagateQuantized(const int16_t accumulator[NNUE_HIDDEN_1]) const;
+        float forward(const uint8_t cells[45], uint8_t currentPlayer) const;
+        float forwardQuantized(const uint8_t cells[45], uint8_t currentPlayer) const;
+        void forwardBatch(const uint8_t positions[][45], const uint8_t players[], size_t n, float values[]) const;
+    };
+
+    extern Network network;
+
+    std::string defaultFileName();
+    bool ensureLoaded();
+
+    size_t pieceFeatures(uint8_t piece, size_t index, uint8_t perspective, size_t features[2]);
+
+    // Quantized first layer outputs (before activation) from the point of view of each player
+    struct Accumulator
+    {
+        alignas(64) int16_t values[2][NNUE_HIDDEN_1];
+
+        void refresh(const uint8_t cells[45]);
+        static void refresh(const uint8_t cells[45], uint8_t perspective, int16_t accumulator[NNUE_HIDDEN_1]);
+        void update(const Accumulator &previous, uint64_t move, const uint8_t previousCells[45], const uint8_t cells[45]);
+    };
+
+    // Search evaluator (see AlphaBeta::TableEvaluator), keeps one accumulator per ply
+    struct Evaluator
+    {
+        static constexpr bool cached = true;
+
+        Accumulator accumulators[MAX_PLY + 1];
+        size_t ply = 0;
+
+        void init(const uint8_t cells[45]);
+        void play(uint64_t move, const uint8_t previousCells[45], const uint8_t cells[45]);
+        void unplay();
+        int64_t evaluate(uint8_t currentPlayer) const;
+        int64_t evaluateMove(uint64_t move, const uint8_t cells[45], uint8_t currentPlayer);
+    };
+}
+
+#endif
@@ -1,11 +1,32 @@
 #ifndef OPTIONS_HPP
 #define OPTIONS_HPP
 #include <cstddef>
+#include <string>
 
 namespace PijersiEngine::Options
 {
     extern size_t threads;
     extern bool verbose;
     extern bool openingBook;
+    extern bool nnue;
+    // NNUE weight file, empty for the default network (NNUE_DEFAULT_FILE)
+    extern std::string evalFile;
+    // Size of the evaluation cache in MB, 0 disables it
+    extern size_t evalCacheSize;
+    // Evaluation parameter or table file (see Evaluation::loadFile), empty for the table compiled in the engine
+    extern std::string evalParamFile;
+    // Search algorithm of the UGI go commands: "alphabeta" or "mcts"
+    extern std::string engine;
+    // Maximum length of the MCTS rollouts in plies, longer rollouts are scored by the evaluation, 0 plays them to the end
+    extern size_t mctsRolloutPlies;
+    // Search MCTS with PUCT and the network evaluation (MCTS::valueFunction) instead of UCT and rollouts
+    extern bool mctsPUCT;
+    // Blend the all-moves-as-first statistics of the rollouts into the UCT selection (RAVE), the PUCT search ignores it
+    extern bool mctsRAVE;
+    // Number of leaves evaluated together by PUCT
+    extern size_t mctsBatchSize;
+    /* Maximum number of nodes of the MCTS tree, the least visited subtrees are pruned when it is reached.
+    Pruning copies the tree to a second arena that keeps its chunks, so up to 1.5 times as many nodes can be allocated. */
+    extern size_t mctsMaxNodes;
 }
 #endif
\ No newline at end of file
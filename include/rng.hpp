@@ -6,7 +6,7 @@
 namespace PijersiEngine::RNG
 {
     extern std::random_device rd; // Obtaining random number from hardware
-    extern std::mt19937 gen; // Seeding generator
+    extern thread_local std::mt19937 gen; // Seeding generator, one per thread so that games can be played concurrently
     extern std::uniform_real_distribution<float> distribution; // Defining uniform distribution
 }
 
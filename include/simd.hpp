@@ -0,0 +1,32 @@
+#ifndef SIMD_HPP
+#define SIMD_HPP
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Number of input vectors that the batched layers multiply by each chunk of weights
+#define SIMD_BATCH_TILE 4
+
+namespace PijersiEngine::SIMD
+{
+    /* Table gathers over the whole board: for every cell k, reads table[pieceToIndex[cells[k]] * 45 + k].
+    This is the access pattern of the evaluation (Evaluation::pieceScores) and of the hashing (Hash::pieceHashKeys).
+    The kernel (AVX-512, AVX2 or scalar) is chosen once at startup from the CPU features. */
+    int64_t gatherSum(const int64_t table[1575], const uint8_t cells[45]);
+    int64_t gatherSum(const int64_t table[1575], const uint8_t cells[45], int64_t values[45]);
+    uint64_t gatherXor(const uint64_t table[1575], const uint8_t cells[45]);
+
+    // Integer dense layer for quantized networks: outputs[o] = sum of inputs[i] * weights[o * nInputs + i], nInputs must be a multiple of 32
+    void affine(const int8_t *weights, const uint8_t *inputs, size_t nInputs, size_t nOutputs, int32_t *outputs);
+    // Same with int16 weights, for the layers that need more precision
+    void affine16(const int16_t *weights, const uint8_t *inputs, size_t nInputs, size_t nOutputs, int32_t *outputs);
+
+    /* Same layers over a batch of nBatch input vectors: outputs[b * nOutputs + o] is the output o of inputs[b * nInputs ...].
+    The batch is a matrix-matrix product: each chunk of weights is loaded once for SIMD_BATCH_TILE input vectors. */
+    void affineBatch(const int8_t *weights, const uint8_t *inputs, size_t nInputs, size_t nOutputs, size_t nBatch, int32_t *outputs);
+    void affine16Batch(const int16_t *weights, const uint8_t *inputs, size_t nInputs, size_t nOutputs, size_t nBatch, int32_t *outputs);
+
+    std::string instructionSet();
+}
+
+#endif
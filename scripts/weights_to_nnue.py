@@ -0,0 +1,63 @@
+"""Converts the network of include/weights.hpp to a float32 NNUE weight file (see NNUE_FILE_MAGIC in include/nnue.hpp).
+
+Usage: python scripts/weights_to_nnue.py [weights.hpp] [output file]
+The default network of the engine, weights/default.nnue, was written by this script."""
+
+import re
+import struct
+import sys
+
+MAGIC = 0x4E4E4A50
+VERSION = 1
+ALIGNMENT = 128
+QUANTIZATION_FLOAT32 = 0
+INPUTS = [720, 256, 32, 32]
+OUTPUTS = [256, 32, 32, 1]
+# Quantization parameters of the engine, they are written even in float files
+WEIGHT_SCALE = 256
+ACTIVATION_SHIFT_1 = 4
+ACTIVATION_SCALE_2 = 16
+MULTIPLIER_SHIFT = 16
+
+LAYERS = ['dense', 'dense_1', 'dense_2', 'dense_3']
+
+
+def fnv1a(data: bytes):
+    hash = 0xCBF29CE484222325
+    for byte in data:
+        hash = ((hash ^ byte) * 0x100000001B3) & 0xFFFFFFFFFFFFFFFF
+    return hash
+
+
+def read_arrays(file_name: str):
+    with open(file_name) as file:
+        text = file.read()
+    arrays = {}
+    for name, values in re.findall(r'const float (\w+)\[\] = \{([^}]*)\}', text):
+        arrays[name] = [float(value) for value in values.split(',') if value.strip()]
+    return arrays
+
+
+def main():
+    input_name = sys.argv[1] if len(sys.argv) >= 2 else 'include/weights.hpp'
+    output_name = sys.argv[2] if len(sys.argv) >= 3 else 'weights/default.nnue'
+    arrays = read_arrays(input_name)
+
+    # Weights then bias of each layer, in the layout of the NN module (weights[input * outputs + output])
+    payload = b''
+    for layer, name in enumerate(LAYERS):
+        weights = arrays[name + '_w']
+        bias = arrays[name + '_b']
+        assert len(weights) == INPUTS[layer] * OUTPUTS[layer] and len(bias) == OUTPUTS[layer], name
+        payload += struct.pack('<%df' % len(weights), *weights)
+        payload += struct.pack('<%df' % len(bias), *bias)
+
+    header = struct.pack('<4I4I4I4IQQ', MAGIC, VERSION, QUANTIZATION_FLOAT32, len(LAYERS), *INPUTS, *OUTPUTS,
+                         WEIGHT_SCALE, ACTIVATION_SHIFT_1, ACTIVATION_SCALE_2, MULTIPLIER_SHIFT, len(payload), fnv1a(payload))
+    with open(output_name, 'wb') as file:
+        file.write(header.ljust(ALIGNMENT, b'\0'))
+        file.write(payload)
+
+
+if __name__ == '__main__':
+    main()
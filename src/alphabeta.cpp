@@ -9,10 +9,14 @@
 #include <omp.h>
 
 #include <alphabeta.hpp>
+#include <evaluation.hpp>
+#include <hash.hpp>
 #include <logic.hpp>
 #include <lookup.hpp>
+#include <nnue.hpp>
 #include <options.hpp>
 #include <rng.hpp>
+#include <simd.hpp>
 #include <utils.hpp>
 
 using std::array;
@@ -25,12 +29,110 @@ using std::chrono::time_point;
 
 namespace PijersiEngine::AlphaBeta
 {
-    int64_t predictedScore = 0;
+    thread_local int64_t predictedScore = 0;
+    std::atomic<uint64_t> nodeCount = 0;
+    std::atomic<uint64_t> evalCacheHits = 0;
+    std::atomic<uint64_t> evalCacheMisses = 0;
+
+    // Nodes visited and cache lookups of the current thread, merged into the totals by the root search
+    thread_local uint64_t threadNodeCount = 0;
+    thread_local uint64_t threadEvalCacheHits = 0;
+    thread_local uint64_t threadEvalCacheMisses = 0;
+
+    // Hash of the position whose moves are evaluated by _evaluateLeafMove, only computed if the evaluator uses the evaluation cache
+    template <class Evaluator>
+    inline uint64_t _leafKey(const uint8_t cells[45], uint8_t currentPlayer)
+    {
+        if constexpr (Evaluator::cached)
+        {
+            if (Hash::evalCache.enabled())
+            {
+                return Hash::hashPosition(cells, currentPlayer);
+            }
+        }
+        return 0;
+    }
+
+    /* Evaluates the position after a move (see TableEvaluator::evaluateMove), through the evaluation cache if the evaluator uses it.
+    cellsKey is the hash of cells (_leafKey), the hash of the position after the move is updated from it. */
+    template <class Evaluator>
+    inline int64_t _evaluateLeafMove(Evaluator &evaluator, uint64_t move, const uint8_t cells[45], uint64_t cellsKey, uint8_t currentPlayer)
+    {
+        if constexpr (Evaluator::cached)
+        {
+            if (Hash::evalCache.enabled())
+            {
+                uint8_t newCells[45];
+                Logic::setState(newCells, cells);
+                Logic::play(move, newCells);
+                uint64_t key = Hash::updateHash(cellsKey, move, cells, newCells);
+                int64_t score;
+                if (Hash::evalCache.probe(key, score))
+                {
+                    threadEvalCacheHits++;
+                    return score;
+                }
+                threadEvalCacheMisses++;
+                score = evaluator.evaluateMove(move, cells, currentPlayer);
+                Hash::evalCache.store(key, score);
+                return score;
+            }
+        }
+        return evaluator.evaluateMove(move, cells, currentPlayer);
+    }
+
+    // Evaluates the position reached by a move (newCells), through the evaluation cache if the evaluator uses it
+    template <class Evaluator>
+    inline int64_t _evaluateLeaf(Evaluator &evaluator, uint64_t move, const uint8_t cells[45], const uint8_t newCells[45], uint8_t currentPlayer)
+    {
+        uint64_t key = 0;
+        if constexpr (Evaluator::cached)
+        {
+            if (Hash::evalCache.enabled())
+            {
+                key = Hash::hashPosition(newCells, currentPlayer);
+                int64_t score;
+                if (Hash::evalCache.probe(key, score))
+                {
+                    threadEvalCacheHits++;
+                    return score;
+                }
+                threadEvalCacheMisses++;
+            }
+        }
+        evaluator.play(move, cells, newCells);
+        int64_t score = evaluator.evaluate(currentPlayer);
+        evaluator.unplay();
+        if constexpr (Evaluator::cached)
+        {
+            if (Hash::evalCache.enabled())
+            {
+                Hash::evalCache.store(key, score);
+            }
+        }
+        return score;
+    }
 
     /* Calculates a move using alphabeta minimax algorithm of chosen depth.
     If a finish time is provided, it will search until that time point is reached.
     In that case, the function will return a null move. */
     uint64_t ponderAlphaBeta(int recursionDepth, bool random, const uint8_t cells[45], uint8_t currentPlayer, uint64_t principalVariation, time_point<steady_clock> finishTime, int64_t* lastScores)
+    {
+        // The evaluators keep one state per ply
+        recursionDepth = std::min(recursionDepth, MAX_PLY);
+
+        // The table evaluation is used if no network can be loaded
+        if (Options::nnue && NNUE::ensureLoaded())
+        {
+            Hash::evalCache.resize(Options::evalCacheSize);
+            return _ponderAlphaBeta<NNUE::Evaluator>(recursionDepth, random, cells, currentPlayer, principalVariation, finishTime, lastScores);
+        }
+        return _ponderAlphaBeta<TableEvaluator>(recursionDepth, random, cells, currentPlayer, principalVariation, finishTime, lastScores);
+    }
+
+    // Root search, Evaluator is the evaluation used in the whole tree (TableEvaluator or NNUE::Evaluator)
+    template <class Evaluator>
+    uint64_t _ponderAlphaBeta(int recursionDepth, bool random, const uint8_t cells[45], uint8_t currentPlayer, uint64_t principalVariation, time_point<steady_clock> finishTime, int64_t* lastScores)
     {
 
         // Get an array of all the available moves for the current player, the last element of the array is the number of available moves
@@ -97,15 +199,28 @@ namespace PijersiEngine::AlphaBeta
                             continue;
                         }
 
+                        uint64_t startNodeCount = threadNodeCount;
+                        uint64_t startEvalCacheHits = threadEvalCacheHits;
+                        uint64_t startEvalCacheMisses = threadEvalCacheMisses;
+
+                        /* Each thread has its own evaluator, the root is the only node where the board is fully evaluated,
+                        the evaluation is then updated move by move */
+                        thread_local Evaluator evaluator;
+                        evaluator.init(cells);
+
                         // Search with a null window
-                        int64_t eval = -evaluateMove(moves[indices[k]], recursionDepth - 1, -alpha - 1, -alpha, cells, 1 - currentPlayer, finishTime, true);
+                        int64_t eval = -evaluateMove(moves[indices[k]], recursionDepth - 1, -alpha - 1, -alpha, cells, 1 - currentPlayer, evaluator, finishTime, true);
 
                         // If fail high, do the search with the full window
                         if (alpha < eval && eval < beta)
                         {
-                            eval = -evaluateMove(moves[indices[k]], recursionDepth - 1, -beta, -alpha, cells, 1 - currentPlayer, finishTime, true);
+                            eval = -evaluateMove(moves[indices[k]], recursionDepth - 1, -beta, -alpha, cells, 1 - currentPlayer, evaluator, finishTime, true);
                         }
 
+                        nodeCount += threadNodeCount - startNodeCount;
+                        evalCacheHits += threadEvalCacheHits - startEvalCacheHits;
+                        evalCacheMisses += threadEvalCacheMisses - startEvalCacheMisses;
+
                         // Update alpha
                         #pragma omp atomic compare
                         if (eval > alpha)
@@ -125,17 +240,25 @@ namespace PijersiEngine::AlphaBeta
                 // On depth 0, run the lightweight eval, only calculating score differences on cells that changed (incremental eval)
                 else
                 {
-                    int64_t previousPieceScores[45] = {0};
-                    int64_t previousScore = evaluatePosition(cells, previousPieceScores);
+                    thread_local Evaluator evaluator;
+                    evaluator.init(cells);
+                    uint64_t cellsKey = _leafKey<Evaluator>(cells, currentPlayer);
+                    uint64_t startNodeCount = threadNodeCount;
+                    uint64_t startEvalCacheHits = threadEvalCacheHits;
+                    uint64_t startEvalCacheMisses = threadEvalCacheMisses;
                     for (size_t k = 0; k < nMoves; k++)
                     {
-                        scores[k] = -evaluateMoveTerminal(moves[k], cells, 1 - currentPlayer, previousScore, previousPieceScores);
+                        threadNodeCount++;
+                        scores[k] = -_evaluateLeafMove(evaluator, moves[k], cells, cellsKey, 1 - currentPlayer);
                         alpha = max(alpha, scores[k]);
                         if (alpha > beta)
                         {
                             break;
                         }
                     }
+                    nodeCount += threadNodeCount - startNodeCount;
+                    evalCacheHits += threadEvalCacheHits - startEvalCacheHits;
+                    evalCacheMisses += threadEvalCacheMisses - startEvalCacheMisses;
                 }
 
                 // Return a null move if time is elapsed
@@ -183,33 +306,21 @@ namespace PijersiEngine::AlphaBeta
     [[nodiscard]]
     inline int64_t evaluatePiece(uint8_t piece, size_t index)
     {
-        return Lookup::pieceScores[Lookup::pieceToIndex[piece] * 45 + index];
+        return Evaluation::table[Lookup::pieceToIndex[piece] * 45 + index];
     }
 
     // Evaluates the board
     [[nodiscard]]
     int64_t evaluatePosition(const uint8_t cells[45])
     {
-        int64_t score = 0;
-        for (size_t k = 0; k < 45; k++)
-        {
-            score += evaluatePiece(cells[k], k);
-        }
-        return score;
+        return SIMD::gatherSum(Evaluation::table, cells);
     }
 
     // Evaluates the board, saves the individual cell scores
     [[nodiscard]]
     int64_t evaluatePosition(const uint8_t cells[45], int64_t pieceScores[45])
     {
-        int64_t totalScore = 0;
-        for (size_t k = 0; k < 45; k++)
-        {
-            int score = evaluatePiece(cells[k], k);
-            pieceScores[k] = score;
-            totalScore += score;
-        }
-        return totalScore;
+        return SIMD::gatherSum(Evaluation::table, cells, pieceScores);
     }
 
     // Update a piece's score according to its last measured score, returns the difference between its current and last score
@@ -235,12 +346,9 @@ namespace PijersiEngine::AlphaBeta
         size_t indexMid = (move >> INDEX_WIDTH) & INDEX_MASK;
         size_t indexEnd = (move >> (2*INDEX_WIDTH)) & INDEX_MASK;
 
-        if ((cells[indexStart] & TYPE_MASK) != TYPE_WISE)
+        if (Logic::isMoveWin(move, cells))
         {
-            if ((currentPlayer == 1 && (indexEnd <= 5)) || (currentPlayer == 0 && (indexEnd >= 39)))
-            {
-                return -MAX_SCORE;
-            }
+            return -MAX_SCORE;
         }
 
         if (indexMid > 44)
@@ -334,18 +442,85 @@ namespace PijersiEngine::AlphaBeta
         return (currentPlayer == 0) ? previousScore : -previousScore;
     }
 
-    // Evaluates a move by calculating the possible subsequent moves recursively
-    int64_t evaluateMove(uint64_t move, int recursionDepth, int64_t alpha, int64_t beta, const uint8_t cells[45], uint8_t currentPlayer, time_point<steady_clock> finishTime, bool allowNullMove)
+    // Sets the root position, this is the only full evaluation of the board
+    void TableEvaluator::init(const uint8_t cells[45])
+    {
+        ply = 0;
+        score = evaluatePosition(cells, pieceScores);
+    }
+
+    /* Updates the score after a move, previousCells is the board before the move and cells the board after it.
+    Only the cells of the move are evaluated again, their previous scores are saved for unplay. */
+    void TableEvaluator::play(uint64_t move, const uint8_t previousCells[45], const uint8_t cells[45])
     {
-        // Stop the recursion if a winning position is achieved
         size_t indexStart = move & INDEX_MASK;
-        size_t indexEnd = (move >> (2 * INDEX_WIDTH)) & INDEX_MASK;
-        if ((cells[indexStart] & TYPE_MASK) != TYPE_WISE)
+        size_t indexMid = (move >> INDEX_WIDTH) & INDEX_MASK;
+        size_t indexEnd = (move >> (2*INDEX_WIDTH)) & INDEX_MASK;
+
+        int64_t *replaced = replacedScores[ply];
+        moves[ply] = move;
+        previousScores[ply] = score;
+
+        replaced[0] = pieceScores[indexStart];
+        pieceScores[indexStart] = evaluatePiece(cells[indexStart], indexStart);
+        score += pieceScores[indexStart] - replaced[0];
+
+        if (indexMid <= 44)
         {
-            if ((currentPlayer == 1 && (indexEnd <= 5)) || (currentPlayer == 0 && (indexEnd >= 39)))
-            {
-                return -MAX_SCORE;
-            }
+            replaced[1] = pieceScores[indexMid];
+            pieceScores[indexMid] = evaluatePiece(cells[indexMid], indexMid);
+            score += pieceScores[indexMid] - replaced[1];
+        }
+
+        replaced[2] = pieceScores[indexEnd];
+        pieceScores[indexEnd] = evaluatePiece(cells[indexEnd], indexEnd);
+        score += pieceScores[indexEnd] - replaced[2];
+
+        ply++;
+    }
+
+    // Goes back to the scores before the last move, in reverse order since the cells of a move are not always distinct
+    void TableEvaluator::unplay()
+    {
+        ply--;
+        uint64_t move = moves[ply];
+        size_t indexStart = move & INDEX_MASK;
+        size_t indexMid = (move >> INDEX_WIDTH) & INDEX_MASK;
+        size_t indexEnd = (move >> (2*INDEX_WIDTH)) & INDEX_MASK;
+
+        const int64_t *replaced = replacedScores[ply];
+        pieceScores[indexEnd] = replaced[2];
+        if (indexMid <= 44)
+        {
+            pieceScores[indexMid] = replaced[1];
+        }
+        pieceScores[indexStart] = replaced[0];
+        score = previousScores[ply];
+    }
+
+    // Evaluates the current position from the point of view of the current player
+    int64_t TableEvaluator::evaluate(uint8_t currentPlayer) const
+    {
+        return (currentPlayer == 0) ? score : -score;
+    }
+
+    // Evaluates the position after a move without keeping it, from the point of view of the player who plays next
+    int64_t TableEvaluator::evaluateMove(uint64_t move, const uint8_t cells[45], uint8_t currentPlayer)
+    {
+        return evaluateMoveTerminal(move, cells, currentPlayer, score, pieceScores);
+    }
+
+    /* Evaluates a move by calculating the possible subsequent moves recursively.
+    The evaluator holds the evaluation of cells, it plays the move before going deeper and is back to cells before returning. */
+    template <class Evaluator>
+    int64_t evaluateMove(uint64_t move, int recursionDepth, int64_t alpha, int64_t beta, const uint8_t cells[45], uint8_t currentPlayer, Evaluator &evaluator, time_point<steady_clock> finishTime, bool allowNullMove)
+    {
+        threadNodeCount++;
+
+        // Stop the recursion if a winning position is achieved
+        if (Logic::isMoveWin(move, cells))
+        {
+            return -MAX_SCORE;
         }
 
         // Create a new board on which the move will be played
@@ -355,7 +530,13 @@ namespace PijersiEngine::AlphaBeta
 
         if (recursionDepth <= 0)
         {
-            return (currentPlayer == 0) ? evaluatePosition(newCells) : -evaluatePosition(newCells);
+            return _evaluateLeaf(evaluator, move, cells, newCells, currentPlayer);
+        }
+
+        // Win in 1: the best reply is known without expanding the node
+        if (Logic::hasWinningMove(currentPlayer, newCells))
+        {
+            return MAX_SCORE;
         }
 
         array<uint64_t, MAX_PLAYER_MOVES> moves = Logic::availablePlayerMoves(currentPlayer, newCells);
@@ -372,6 +553,8 @@ namespace PijersiEngine::AlphaBeta
         // Evaluate available moves and find the best one
         if (nMoves > 0)
         {
+            evaluator.play(move, cells, newCells);
+
             if (recursionDepth > 1)
             {
                 for (size_t k = 0; k < nMoves; k++)
@@ -379,17 +562,17 @@ namespace PijersiEngine::AlphaBeta
                     int64_t eval = INT64_MIN;
                     if (k==0)
                     {
-                        eval = -evaluateMove(moves[k], recursionDepth - 1, -beta, -alpha, newCells, 1 - currentPlayer, finishTime, allowNullMove);
+                        eval = -evaluateMove(moves[k], recursionDepth - 1, -beta, -alpha, newCells, 1 - currentPlayer, evaluator, finishTime, allowNullMove);
                     }
                     else
                     {
                         // Search with a null window
-                        eval = -evaluateMove(moves[k], recursionDepth - 1, -alpha - 1, -alpha, newCells, 1 - currentPlayer, finishTime, allowNullMove);
+                        eval = -evaluateMove(moves[k], recursionDepth - 1, -alpha - 1, -alpha, newCells, 1 - currentPlayer, evaluator, finishTime, allowNullMove);
 
                         // If fail high, do the search with the full window
                         if (alpha < eval && eval < beta)
                         {
-                            eval = -evaluateMove(moves[k], recursionDepth - 1, -beta, -alpha, newCells, 1 - currentPlayer, finishTime, allowNullMove);
+                            eval = -evaluateMove(moves[k], recursionDepth - 1, -beta, -alpha, newCells, 1 - currentPlayer, evaluator, finishTime, allowNullMove);
                         }
                     }
                     score = max(score, eval);
@@ -402,11 +585,11 @@ namespace PijersiEngine::AlphaBeta
             }
             else
             {
-                int64_t previousPieceScores[45] = {0};
-                int64_t previousScore = evaluatePosition(newCells, previousPieceScores);
+                uint64_t cellsKey = _leafKey<Evaluator>(newCells, currentPlayer);
                 for (size_t k = 0; k < nMoves; k++)
                 {
-                    score = max(score, -evaluateMoveTerminal(moves[k], newCells, 1 - currentPlayer, previousScore, previousPieceScores));
+                    threadNodeCount++;
+                    score = max(score, -_evaluateLeafMove(evaluator, moves[k], newCells, cellsKey, 1 - currentPlayer));
                     alpha = max(alpha, score);
                     if (alpha > beta)
                     {
@@ -414,23 +597,21 @@ namespace PijersiEngine::AlphaBeta
                     }
                 }
             }
+
+            evaluator.unplay();
         }
 
         return score;
     }
 
     // Evaluates a move by calculating the possible subsequent moves recursively
-    int64_t evaluateMoveParallel(uint64_t move, int recursionDepth, int64_t alpha, int64_t beta, const uint8_t cells[45], uint8_t currentPlayer, time_point<steady_clock> finishTime, bool allowNullMove)
+    template <class Evaluator>
+    int64_t evaluateMoveParallel(uint64_t move, int recursionDepth, int64_t alpha, int64_t beta, const uint8_t cells[45], uint8_t currentPlayer, Evaluator &evaluator, time_point<steady_clock> finishTime, bool allowNullMove)
     {
         // Stop the recursion if a winning position is achieved
-        size_t indexStart = move & INDEX_MASK;
-        size_t indexEnd = (move >> (2 * INDEX_WIDTH)) & INDEX_MASK;
-        if ((cells[indexStart] & TYPE_MASK) != TYPE_WISE)
+        if (Logic::isMoveWin(move, cells))
         {
-            if ((currentPlayer == 1 && (indexEnd <= 5)) || (currentPlayer == 0 && (indexEnd >= 39)))
-            {
-                return -MAX_SCORE;
-            }
+            return -MAX_SCORE;
         }
 
         // Create a new board on which the move will be played
@@ -440,7 +621,7 @@ namespace PijersiEngine::AlphaBeta
 
         if (recursionDepth <= 0)
         {
-            return (currentPlayer == 0) ? evaluatePosition(newCells) : -evaluatePosition(newCells);
+            return _evaluateLeaf(evaluator, move, cells, newCells, currentPlayer);
         }
 
         array<uint64_t, MAX_PLAYER_MOVES> moves = Logic::availablePlayerMoves(currentPlayer, newCells);
@@ -457,6 +638,7 @@ namespace PijersiEngine::AlphaBeta
         // Evaluate available moves and find the best one
         if (nMoves > 0)
         {
+            evaluator.play(move, cells, newCells);
 
             if (recursionDepth > 1)
             {
@@ -468,7 +650,10 @@ namespace PijersiEngine::AlphaBeta
                     {
                         continue;
                     }
-                    int64_t eval = -evaluateMove(moves[k], recursionDepth - 1, -beta, -alpha, newCells, 1 - currentPlayer, finishTime, allowNullMove);
+                    // Each thread has its own evaluator, set to the position after the move
+                    thread_local Evaluator threadEvaluator;
+                    threadEvaluator.init(newCells);
+                    int64_t eval = -evaluateMove(moves[k], recursionDepth - 1, -beta, -alpha, newCells, 1 - currentPlayer, threadEvaluator, finishTime, allowNullMove);
                     #pragma omp atomic compare
                     if (eval > score)
                     {
@@ -487,11 +672,11 @@ namespace PijersiEngine::AlphaBeta
             }
             else
             {
-                int64_t previousPieceScores[45] = {0};
-                int64_t previousScore = evaluatePosition(newCells, previousPieceScores);
+                uint64_t cellsKey = _leafKey<Evaluator>(newCells, currentPlayer);
                 for (size_t k = 0; k < nMoves; k++)
                 {
-                    score = max(score, -evaluateMoveTerminal(moves[k], newCells, 1 - currentPlayer, previousScore, previousPieceScores));
+                    threadNodeCount++;
+                    score = max(score, -_evaluateLeafMove(evaluator, moves[k], newCells, cellsKey, 1 - currentPlayer));
                     alpha = max(alpha, score);
                     if (alpha > beta)
                     {
@@ -499,6 +684,8 @@ namespace PijersiEngine::AlphaBeta
                     }
                 }
             }
+
+            evaluator.unplay();
         }
 
         return score;
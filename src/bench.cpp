@@ -0,0 +1,23 @@
+#include <cstdlib>
+#include <string>
+
+#include <benchmark.hpp>
+
+using namespace PijersiEngine;
+
+int main(int argc, char** argv)
+{
+    // bench [search depth] [perft depth]
+    int searchDepth = BENCH_SEARCH_DEPTH;
+    int perftDepth = BENCH_PERFT_DEPTH;
+    if (argc >= 2)
+    {
+        searchDepth = std::stoi(argv[1]);
+    }
+    if (argc >= 3)
+    {
+        perftDepth = std::stoi(argv[2]);
+    }
+    Benchmark::run(perftDepth, searchDepth);
+    return EXIT_SUCCESS;
+}
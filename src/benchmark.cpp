@@ -0,0 +1,109 @@
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <alphabeta.hpp>
+#include <benchmark.hpp>
+#include <board.hpp>
+#include <logic.hpp>
+#include <options.hpp>
+#include <simd.hpp>
+
+using namespace std::chrono;
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+
+namespace PijersiEngine::Benchmark
+{
+    const vector<string> positions = {
+        // Opening
+        "s-p-r-s-p-r-/p-r-s-wwr-s-p-/6/7/6/P-S-R-WWS-R-P-/R-P-S-R-P-S- w 0 1",
+        "s-p-r-s-p-r-/p-r-s-wwr-s-p-/6/7/P-5/1S-R-WWS-R-P-/R-P-S-R-P-S- b 1 1",
+        // Middlegame
+        "s-2s-p-r-/p-1rpwwr-s-p-/r-5/s-3W-W-1/2S-R-2/P-S-R-1S-R-P-/R-P-2P-S- w 6 4",
+        "s-p-1s-p-r-/pr2wwr-s-p-/1s-4/1r-SR4/4SRRP/P-1R-WW3/1P-S-1P-S- w 6 4",
+        // Stack-heavy
+        "s-p-r-1sp1/1rsp-1wwrp1/6/7/6/1SPWW1RPP-1/R-1PS2S- w 0 10",
+        "1sr2p-1/p-1rp1ww1s-/2sp3/7/3RS2/1P-2WWPR1/R-2SP2 b 2 9",
+        // Endgame
+        "2s-1r-1/3ww3/1p-4/2R-1r-2/6/2WW2S-1/1P-4 w 0 30",
+        "6/1s-ww2p-1/2r-3/7/1P-R-3/2WW4/6 b 2 35"
+    };
+
+    // Mixes a value into a 64-bit FNV-1a hash
+    inline uint64_t _fnv1a(uint64_t hash, uint64_t value)
+    {
+        for (int k = 0; k < 8; k++)
+        {
+            hash ^= (value >> (8 * k)) & 0xFFU;
+            hash *= 0x100000001B3ULL;
+        }
+        return hash;
+    }
+
+    /* Runs every position of the suite through perft, evaluation and a fixed-depth search.
+    The search is single-threaded with the opening book disabled so that node counts are reproducible.
+    The signature only depends on the search results (nodes, scores and best moves). */
+    Result run(int perftDepth, int searchDepth, bool verbose)
+    {
+        size_t threads = Options::threads;
+        bool searchVerbose = Options::verbose;
+        bool openingBook = Options::openingBook;
+        Options::threads = 1;
+        Options::verbose = false;
+        Options::openingBook = false;
+
+        Result result;
+        result.signature = 0xCBF29CE484222325ULL;
+
+        Board board;
+        auto start = steady_clock::now();
+        for (size_t k = 0; k < positions.size(); k++)
+        {
+            board.setStringState(positions[k]);
+
+            uint64_t perftNodes = Logic::perft(perftDepth, board.cells, board.currentPlayer);
+            int64_t eval = board.evaluate();
+            uint64_t move = board.searchDepth(searchDepth, false);
+            uint64_t searchNodes = AlphaBeta::nodeCount;
+
+            result.perftNodes += perftNodes;
+            result.searchNodes += searchNodes;
+            result.signature = _fnv1a(result.signature, searchNodes);
+            result.signature = _fnv1a(result.signature, AlphaBeta::predictedScore);
+            result.signature = _fnv1a(result.signature, eval);
+            result.signature = _fnv1a(result.signature, move & NULL_MOVE);
+
+            if (verbose)
+            {
+                cout << "Position " << k + 1 << "/" << positions.size() << ": " << positions[k] << endl;
+                cout << "perft " << perftDepth << ": " << perftNodes << " | eval: " << eval << " | depth " << searchDepth << ": " << Logic::moveToString(move, board.cells) << " score " << AlphaBeta::predictedScore << " nodes " << searchNodes << endl;
+            }
+        }
+        auto end = steady_clock::now();
+        result.durationMilliseconds = duration_cast<milliseconds>(end - start).count();
+
+        Options::threads = threads;
+        Options::verbose = searchVerbose;
+        Options::openingBook = openingBook;
+
+        if (verbose)
+        {
+            uint64_t totalNodes = result.perftNodes + result.searchNodes;
+            cout << "===========================" << endl;
+            cout << "Total time (ms) : " << result.durationMilliseconds << endl;
+            cout << "Perft nodes     : " << result.perftNodes << endl;
+            cout << "Search nodes    : " << result.searchNodes << endl;
+            cout << "Total nodes     : " << totalNodes << endl;
+            cout << "Signature       : " << std::hex << result.signature << std::dec << endl;
+            cout << "Nodes/second    : " << 1000 * totalNodes / (result.durationMilliseconds + 1) << endl;
+            cout << "Eval kernel     : " << SIMD::instructionSet() << endl;
+        }
+
+        return result;
+    }
+}
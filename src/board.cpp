@@ -8,6 +8,7 @@
 #include <alphabeta.hpp>
 #include <board.hpp>
 #include <logic.hpp>
+#include <mcts.hpp>
 #include <openings.hpp>
 #include <options.hpp>
 #include <rng.hpp>
@@ -26,7 +27,15 @@ namespace PijersiEngine
     // Prints the move info in UGI format
     void printInfo(int recursionDepth, float duration, int predictedScore, string moveString)
     {
-        cout << "info depth " << recursionDepth << " time " << duration << " score " << predictedScore << " pv " << moveString << endl;
+        cout << "info depth " << recursionDepth << " time " << duration << " score " << predictedScore;
+        // Evaluation cache statistics, only when the evaluator uses the cache
+        uint64_t evalCacheHits = AlphaBeta::evalCacheHits;
+        uint64_t evalCacheLookups = evalCacheHits + AlphaBeta::evalCacheMisses;
+        if (evalCacheLookups > 0)
+        {
+            cout << " cachehits " << evalCacheHits << " cachemisses " << evalCacheLookups - evalCacheHits << " cachehitrate " << 100 * evalCacheHits / evalCacheLookups;
+        }
+        cout << " pv " << moveString << endl;
     }
 
     // Search the move book. If the position is in the book, return the best move. Otherwise return the null move.
@@ -141,6 +150,10 @@ namespace PijersiEngine
             }
         }
 
+        AlphaBeta::nodeCount = 0;
+        AlphaBeta::evalCacheHits = 0;
+        AlphaBeta::evalCacheMisses = 0;
+
         uint64_t move = NULL_MOVE;
         if (iterative)
         {
@@ -241,6 +254,10 @@ namespace PijersiEngine
         time_point<steady_clock> finishTime;
         finishTime = steady_clock::now() + std::chrono::milliseconds(searchTimeMilliseconds);
 
+        AlphaBeta::nodeCount = 0;
+        AlphaBeta::evalCacheHits = 0;
+        AlphaBeta::evalCacheMisses = 0;
+
         uint64_t move = NULL_MOVE;
         size_t nMoves = Logic::availablePlayerMoves(currentPlayer, cells)[MAX_PLAYER_MOVES - 1];
         int64_t *scores = new int64_t[nMoves];
@@ -305,6 +322,46 @@ namespace PijersiEngine
         return move;
     }
 
+    // Calculates a move with MCTS and plays it
+    uint64_t Board::playMCTS(uint64_t searchTimeMilliseconds, uint64_t maxNodes, int simulationsPerRollout)
+    {
+        uint64_t move = searchMCTS(searchTimeMilliseconds, maxNodes, simulationsPerRollout);
+        if (move != NULL_MOVE)
+        {
+            playManual(move);
+        }
+        return move;
+    }
+
+    /* Calculates a move using Monte Carlo tree search (see Options::mctsPUCT for the mode).
+    The search stops after the provided duration in milliseconds or after maxNodes visits of the root, whichever comes first.
+    It also stops early once the position is solved. A duration of UINT64_MAX removes the time limit.
+    If there is no legal move, the engine will return a null move. */
+    uint64_t Board::searchMCTS(uint64_t searchTimeMilliseconds, uint64_t maxNodes, int simulationsPerRollout)
+    {
+        if (Options::openingBook)
+        {
+            uint64_t bookMove = searchBook();
+            if (bookMove != NULL_MOVE)
+            {
+                return bookMove;
+            }
+        }
+
+        // Calculate finish time point
+        time_point<steady_clock> finishTime;
+        if (searchTimeMilliseconds == UINT64_MAX)
+        {
+            finishTime = time_point<steady_clock>::max();
+        }
+        else
+        {
+            finishTime = steady_clock::now() + std::chrono::milliseconds(searchTimeMilliseconds);
+        }
+
+        return MCTS::ponderMCTS(finishTime, maxNodes, simulationsPerRollout, cells, currentPlayer);
+    }
+
     // TODO: this will fail
     bool Board::isMoveLegal(uint64_t move)
     {
@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <evaluation.hpp>
+#include <logic.hpp>
+#include <lookup.hpp>
+
+namespace PijersiEngine::Evaluation
+{
+    alignas(64) int64_t pieceScores[1575];
+    thread_local constinit const int64_t *table = pieceScores;
+
+    [[maybe_unused]] const bool tableInitialized = (resetTable(), true);
+
+    // Score of a piece on a cell from White's point of view, it is linear in the parameters
+    float Parameters::pieceScore(uint8_t piece, size_t index) const
+    {
+        bool black = (piece & COLOUR_MASK) != 0;
+        uint8_t top = piece & TOP_MASK;
+        float score;
+        if ((top & TYPE_MASK) != TYPE_WISE)
+        {
+            // Lines counted from the side of the piece, the goal is the last one
+            size_t line = black ? Logic::indexToLine[index] : 6 - Logic::indexToLine[index];
+            score = values[line];
+            if (line == 6)
+            {
+                score *= EVAL_GOAL_MULTIPLIER;
+            }
+        }
+        else
+        {
+            score = values[8];
+        }
+        if (piece >= 16)
+        {
+            score = 2 * score + values[7];
+        }
+        return black ? -score : score;
+    }
+
+    // Builds the piece table from the parameters
+    void Parameters::fillTable(int64_t table[1575]) const
+    {
+        std::fill(table, table + 1575, 0);
+        for (size_t piece = 0; piece < 256; piece++)
+        {
+            size_t pieceIndex = Lookup::pieceToIndex[piece];
+            // Invalid pieces and empty cells
+            if (pieceIndex == 34)
+            {
+                continue;
+            }
+            for (size_t index = 0; index < 45; index++)
+            {
+                table[pieceIndex * 45 + index] = (int64_t)pieceScore(piece, index);
+            }
+        }
+    }
+
+    // Reads N_EVAL_PARAMETERS numbers separated by spaces, the parameters are unchanged if the text is invalid
+    bool Parameters::parse(const std::string &text)
+    {
+        std::istringstream stream(text);
+        float newValues[N_EVAL_PARAMETERS];
+        for (size_t k = 0; k < N_EVAL_PARAMETERS; k++)
+        {
+            if (!(stream >> newValues[k]))
+            {
+                return false;
+            }
+        }
+        std::string rest;
+        if (stream >> rest)
+        {
+            return false;
+        }
+        std::copy(newValues, newValues + N_EVAL_PARAMETERS, values);
+        return true;
+    }
+
+    std::string Parameters::toString() const
+    {
+        std::ostringstream stream;
+        for (size_t k = 0; k < N_EVAL_PARAMETERS; k++)
+        {
+            stream << (k > 0 ? " " : "") << values[k];
+        }
+        return stream.str();
+    }
+
+    // Goes back to the table compiled in the engine
+    void resetTable()
+    {
+        std::copy(Lookup::pieceScores, Lookup::pieceScores + 1575, pieceScores);
+    }
+
+    void setParameters(const Parameters &parameters)
+    {
+        parameters.fillTable(pieceScores);
+    }
+
+    void setTable(const int64_t newTable[1575])
+    {
+        std::copy(newTable, newTable + 1575, pieceScores);
+    }
+
+    // Makes the current thread evaluate with its own table, which must outlive its use, nullptr goes back to pieceScores
+    void setThreadTable(const int64_t *threadTable)
+    {
+        table = (threadTable != nullptr) ? threadTable : pieceScores;
+    }
+
+    /* Loads a file of numbers separated by whitespace, lines starting with # are comments.
+    It holds either N_EVAL_PARAMETERS parameters or the 1575 values of a table (the output of saveTable).
+    The table is unchanged if the file is invalid. */
+    bool loadFile(const std::string &fileName)
+    {
+        std::ifstream file(fileName);
+        if (!file)
+        {
+            return false;
+        }
+        std::vector<double> numbers;
+        std::string line;
+        while (std::getline(file, line))
+        {
+            if (!line.empty() && line[0] == '#')
+            {
+                continue;
+            }
+            std::istringstream stream(line);
+            double number;
+            while (stream >> number)
+            {
+                numbers.push_back(number);
+            }
+            if (!stream.eof())
+            {
+                return false;
+            }
+        }
+
+        if (numbers.size() == N_EVAL_PARAMETERS)
+        {
+            Parameters parameters;
+            std::copy(numbers.begin(), numbers.end(), parameters.values);
+            setParameters(parameters);
+            return true;
+        }
+        if (numbers.size() == 1575)
+        {
+            int64_t newTable[1575];
+            for (size_t k = 0; k < 1575; k++)
+            {
+                newTable[k] = (int64_t)numbers[k];
+            }
+            setTable(newTable);
+            return true;
+        }
+        return false;
+    }
+
+    // Writes a table in the format of loadFile, one piece per line
+    bool saveTable(const std::string &fileName, const int64_t table[1575])
+    {
+        std::ofstream file(fileName, std::ios::trunc);
+        if (!file)
+        {
+            return false;
+        }
+        file << "# Piece table, one line per piece index (Lookup::pieceToIndex), one value per cell" << std::endl;
+        for (size_t pieceIndex = 0; pieceIndex < 35; pieceIndex++)
+        {
+            for (size_t index = 0; index < 45; index++)
+            {
+                file << (index > 0 ? " " : "") << table[pieceIndex * 45 + index];
+            }
+            file << std::endl;
+        }
+        return (bool)file;
+    }
+}
@@ -73,5 +73,25 @@ int main(int argc, char** argv)
             }
         }
     }
+    else if (mode == "m")
+    {
+        uint64_t durationMilliseconds = stoull(parameter);
+        uint64_t move = board.searchMCTS(durationMilliseconds);
+        if (move != NULL_MOVE)
+        {
+            string moveString = Logic::moveToString(move, board.cells);
+            cout << moveString << endl;
+        }
+    }
+    else if (mode == "n")
+    {
+        uint64_t maxNodes = stoull(parameter);
+        uint64_t move = board.searchMCTS(UINT64_MAX, maxNodes);
+        if (move != NULL_MOVE)
+        {
+            string moveString = Logic::moveToString(move, board.cells);
+            cout << moveString << endl;
+        }
+    }
     return 0;
 }
\ No newline at end of file
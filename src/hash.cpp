@@ -1,8 +1,9 @@
 #include <random>
 
 #include <hash.hpp>
+#include <logic.hpp>
 #include <lookup.hpp>
-#include <rng.hpp>
+#include <simd.hpp>
 
 namespace PijersiEngine::Hash
 {
@@ -10,38 +11,101 @@ namespace PijersiEngine::Hash
 
     uint64_t pieceHashKeys[1575];
     uint64_t depthHashKeys[20];
+    uint64_t playerHashKey;
     LRUCache<uint64_t, uint64_t> hashTable(1024*1024*1024);
+    EvalCache evalCache;
 
+    /* The keys are drawn from a fixed seed so that hashes are the same from one run to the next,
+    they are set at startup since RNG::gen may not be constructed yet */
     void hashInit()
     {
+        std::mt19937_64 keyGenerator(0x5A17C0DEULL);
         for (int index = 0; index < 1530; index++)
         {
-            pieceHashKeys[index] = uint64rng(RNG::gen);
+            pieceHashKeys[index] = uint64rng(keyGenerator);
         }
+        // Empty cells
         for (int index = 1530; index < 1575; index++)
         {
             pieceHashKeys[index] = 0;
         }
         for (int index = 0; index < 20; index++)
         {
-            depthHashKeys[index] = uint64rng(RNG::gen);
+            depthHashKeys[index] = uint64rng(keyGenerator);
         }
+        playerHashKey = uint64rng(keyGenerator);
     }
 
+    [[maybe_unused]] const bool keysInitialized = (hashInit(), true);
+
     uint64_t hashPiece(uint8_t piece, int index)
     {
         return pieceHashKeys[Lookup::pieceToIndex[piece] * 45 + index];
     }
 
-    // TODO: Implement incremental hashing
-    uint64_t hash(uint8_t cells[45], int recursionDepth)
+    // Hash of a position and of the player to move
+    uint64_t hashPosition(const uint8_t cells[45], uint8_t currentPlayer)
+    {
+        return SIMD::gatherXor(pieceHashKeys, cells) ^ (currentPlayer * playerHashKey);
+    }
+
+    /* Hash of the position after a move from the hash of the position before it (hashPosition), only the cells of the move are hashed again.
+    previousCells is the board before the move and cells the board after it. */
+    uint64_t updateHash(uint64_t key, uint64_t move, const uint8_t previousCells[45], const uint8_t cells[45])
+    {
+        size_t indexStart = move & INDEX_MASK;
+        size_t indexMid = (move >> INDEX_WIDTH) & INDEX_MASK;
+        size_t indexEnd = (move >> (2 * INDEX_WIDTH)) & INDEX_MASK;
+
+        key ^= hashPiece(previousCells[indexStart], indexStart) ^ hashPiece(cells[indexStart], indexStart);
+        // The cells of a move are not always distinct
+        if (indexMid <= 44 && indexMid != indexStart)
+        {
+            key ^= hashPiece(previousCells[indexMid], indexMid) ^ hashPiece(cells[indexMid], indexMid);
+        }
+        if (indexEnd != indexStart && indexEnd != indexMid)
+        {
+            key ^= hashPiece(previousCells[indexEnd], indexEnd) ^ hashPiece(cells[indexEnd], indexEnd);
+        }
+        return key ^ playerHashKey;
+    }
+
+    // Sets the size of the cache (rounded down to a power of 2 entries) and clears it, 0 disables the cache
+    void EvalCache::resize(size_t newSizeMegabytes)
     {
-        uint64_t result = 0;
-        for (int index = 0; index < 45; index++)
+        if (newSizeMegabytes == sizeMegabytes && (entries != nullptr || newSizeMegabytes == 0))
         {
-            result ^= hashPiece(cells[index], index);
+            return;
         }
-        result ^= depthHashKeys[recursionDepth];
-        return result;
+        sizeMegabytes = newSizeMegabytes;
+        size_t maxEntries = newSizeMegabytes * 1024 * 1024 / sizeof(Entry);
+        nEntries = 0;
+        entries.reset();
+        if (maxEntries == 0)
+        {
+            return;
+        }
+        nEntries = 1;
+        while (2 * nEntries <= maxEntries)
+        {
+            nEntries *= 2;
+        }
+        entries = std::make_unique<Entry[]>(nEntries);
+        clear();
+    }
+
+    void EvalCache::clear()
+    {
+        for (size_t k = 0; k < nEntries; k++)
+        {
+            entries[k].check.store(0, std::memory_order_relaxed);
+            entries[k].score.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // TODO: Implement incremental hashing
+    uint64_t hash(uint8_t cells[45], int recursionDepth)
+    {
+        return SIMD::gatherXor(pieceHashKeys, cells) ^ depthHashKeys[recursionDepth];
     }
 }
\ No newline at end of file
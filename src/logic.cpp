@@ -372,8 +372,18 @@ namespace PijersiEngine::Logic
         setState(targetCells, newCells);
     }
 
-    // Returns the list of possible moves for a specific piece
-    uint64_t _countPieceMoves(uint64_t indexStart, const uint8_t cells[45])
+    // Adds a landing cell to the reach mask if one is requested
+    inline void _addReach(uint64_t *reach, uint64_t index)
+    {
+        if (reach != nullptr)
+        {
+            *reach |= 1ULL << index;
+        }
+    }
+
+    /* Returns the number of possible moves for a specific piece.
+    If a reach mask is provided, the cells where the piece can land with a move or an unstack (and capture an enemy piece standing there) are added to it. */
+    inline uint64_t _countPieceMoves(uint64_t indexStart, const uint8_t cells[45], uint64_t *reach = nullptr)
     {
         uint8_t movingPiece = cells[indexStart];
 
@@ -396,6 +406,7 @@ namespace PijersiEngine::Logic
                         if (isMove2Valid(movingPiece, indexMid, indexEnd, cells) || ((indexStart == (indexMid + indexEnd) / 2) && isMoveValid(movingPiece, indexEnd, cells)))
                         {
                             count++;
+                            _addReach(reach, indexEnd);
                         }
                     }
 
@@ -406,6 +417,7 @@ namespace PijersiEngine::Logic
                         if (isMoveValid(movingPiece, indexEnd, cells) || (indexStart == indexEnd))
                         {
                             count++;
+                            _addReach(reach, indexEnd);
                         }
                     }
 
@@ -416,6 +428,7 @@ namespace PijersiEngine::Logic
                 else if (isMoveValid(movingPiece, indexMid, cells))
                 {
                     count++;
+                    _addReach(reach, indexMid);
                 }
             }
         }
@@ -435,6 +448,7 @@ namespace PijersiEngine::Logic
                         if (isUnstackValid(movingPiece, indexEnd, cells))
                         {
                             count++;
+                            _addReach(reach, indexEnd);
                         }
 
                         // 2-range move, stack
@@ -446,6 +460,7 @@ namespace PijersiEngine::Logic
 
                     // 2-range move
                     count++;
+                    _addReach(reach, indexMid);
                 }
             }
             // 1-range first action
@@ -464,6 +479,7 @@ namespace PijersiEngine::Logic
                         if (isUnstackValid(movingPiece, indexEnd, cells))
                         {
                             count++;
+                            _addReach(reach, indexEnd);
                         }
 
                         // 1-range move, stack
@@ -477,6 +493,7 @@ namespace PijersiEngine::Logic
 
                     // 1-range move
                     count++;
+                    _addReach(reach, indexMid);
                 }
                 // stack, [1/2-range move] optional
                 else if (isStackValid(movingPiece, indexMid, cells))
@@ -488,6 +505,7 @@ namespace PijersiEngine::Logic
                         if (isMove2Valid(movingPiece, indexMid, indexEnd, cells))
                         {
                             count++;
+                            _addReach(reach, indexEnd);
                         }
                     }
 
@@ -498,6 +516,7 @@ namespace PijersiEngine::Logic
                         if (isMoveValid(movingPiece, indexEnd, cells))
                         {
                             count++;
+                            _addReach(reach, indexEnd);
                         }
                     }
 
@@ -510,13 +529,27 @@ namespace PijersiEngine::Logic
                 {
                     // unstack only
                     count++;
+                    _addReach(reach, indexMid);
                 }
             }
         }
 
+        // Coming back to the starting cell is not a landing
+        if (reach != nullptr)
+        {
+            *reach &= ~(1ULL << indexStart);
+        }
+
         return count;
     }
 
+    // Returns the number of possible moves for a specific piece and the cells it can land on
+    uint64_t pieceMobility(uint64_t indexStart, const uint8_t cells[45], uint64_t &reach)
+    {
+        reach = 0;
+        return _countPieceMoves(indexStart, cells, &reach);
+    }
+
     // Returns the number of possible moves for a player
     uint64_t _countPlayerMoves(uint8_t player, const uint8_t cells[45])
     {
@@ -765,6 +798,43 @@ namespace PijersiEngine::Logic
         cells[indexEnd] = pieceEnd;
     }
 
+    // Returns the move with the pieces of its start, mid and end cells saved in its upper bits, so that unplay can undo it
+    uint64_t attachPieces(uint64_t move, const uint8_t cells[45])
+    {
+        uint64_t indexStart = move & INDEX_MASK;
+        uint64_t indexMid = (move >> INDEX_WIDTH) & INDEX_MASK;
+        uint64_t indexEnd = (move >> (2*INDEX_WIDTH)) & INDEX_MASK;
+        uint64_t pieceMid = (indexMid <= 44) ? cells[indexMid] : 0;
+        return (move & NULL_MOVE) | _concatenatePieces(cells[indexStart], pieceMid, cells[indexEnd]);
+    }
+
+    // Returns the compact id of a move (see Lookup::moveIds), COMPACT_NULL_MOVE if the move is not geometrically possible
+    uint16_t compressMove(uint64_t move)
+    {
+        uint64_t indexStart = move & INDEX_MASK;
+        uint64_t indexMid = (move >> INDEX_WIDTH) & INDEX_MASK;
+        uint64_t indexEnd = (move >> (2*INDEX_WIDTH)) & INDEX_MASK;
+        if (indexStart > 44 || indexEnd > 44)
+        {
+            return COMPACT_NULL_MOVE;
+        }
+        if (indexMid > 44)
+        {
+            indexMid = 45;
+        }
+        return Lookup::moveIds[(indexStart * 46 + indexMid) * 45 + indexEnd];
+    }
+
+    // Returns the move of a compact id, without its pieces (see attachPieces)
+    uint64_t decompressMove(uint16_t moveId)
+    {
+        if (moveId >= Lookup::moveIdCount)
+        {
+            return NULL_MOVE;
+        }
+        return Lookup::moves[moveId];
+    }
+
     void playManual(uint64_t move, uint8_t cells[45])
     {
         play(move, cells);
@@ -798,77 +868,199 @@ namespace PijersiEngine::Logic
         return move;
     }
 
+    // Returns the non-Wise pieces of each colour standing on their goal row, one bit per cell (bit 0 of each byte)
+    // The goal rows are loaded as 64-bit little-endian words: cells 0 to 5 for White, cells 39 to 44 for Black
+    inline void _goalRowWinners(const uint8_t cells[45], uint64_t &whiteWinners, uint64_t &blackWinners)
+    {
+        uint64_t whiteRow;
+        uint64_t blackRow;
+        std::memcpy(&whiteRow, cells, 8);
+        std::memcpy(&blackRow, cells + 37, 8);
+        blackRow >>= 2 * INDEX_WIDTH;
+
+        // Piece present, colour bit cleared (White) and type bits not both set (not Wise)
+        whiteWinners = whiteRow & ~(whiteRow >> 1) & ~((whiteRow >> 2) & (whiteRow >> 3)) & GOAL_ROW_BYTES;
+        // Piece present, colour bit set (Black) and type bits not both set (not Wise)
+        blackWinners = blackRow & (blackRow >> 1) & ~((blackRow >> 2) & (blackRow >> 3)) & GOAL_ROW_BYTES;
+    }
+
     // Returns true if the board is in a winning position
     bool isPositionWin(const uint8_t cells[45])
     {
-        for (int k = 0; k < 6; k++)
+        uint64_t whiteWinners;
+        uint64_t blackWinners;
+        _goalRowWinners(cells, whiteWinners, blackWinners);
+        return (whiteWinners | blackWinners) != 0;
+    }
+
+    // Returns 0 if the winning player is white, 1 if black, 0xFF if no winning player
+    uint8_t getWinningPlayer(const uint8_t cells[45])
+    {
+        uint64_t whiteWinners;
+        uint64_t blackWinners;
+        _goalRowWinners(cells, whiteWinners, blackWinners);
+        if (whiteWinners != 0)
+        {
+            return 0U;
+        }
+        if (blackWinners != 0)
+        {
+            return 1U;
+        }
+        return 0xFFU;
+    }
+
+    // Returns true if the piece can reach a cell of the goal mask in one move
+    // Follows the same structure as availablePieceMoves, but only tests the actions that end on the goal row
+    bool _hasPieceWinningMove(uint64_t indexStart, const uint8_t cells[45], uint64_t goalMask)
+    {
+        uint8_t movingPiece = cells[indexStart];
+
+        // If the piece is not a stack
+        if (movingPiece < 16)
         {
-            if (cells[k] != 0)
+            // 1-range first action
+            for (size_t indexMidLoop = 7 * indexStart + 1; indexMidLoop < 7 * indexStart + Lookup::neighbours[7 * indexStart] + 1; indexMidLoop++)
             {
-                // If piece is White and not Wise
-                if ((cells[k] & COLOUR_MASK) == COLOUR_WHITE && (cells[k] & TYPE_MASK) != TYPE_WISE)
+                uint64_t indexMid = Lookup::neighbours[indexMidLoop];
+                // stack, [1/2-range move] optional
+                if (isStackValid(movingPiece, indexMid, cells))
+                {
+                    // stack only
+                    if ((goalMask >> indexMid) & 1)
+                    {
+                        return true;
+                    }
+
+                    // stack, 2-range move
+                    for (size_t indexEndLoop = 7 * indexMid + 1; indexEndLoop < 7 * indexMid + Lookup::neighbours2[7 * indexMid] + 1; indexEndLoop++)
+                    {
+                        uint64_t indexEnd = Lookup::neighbours2[indexEndLoop];
+                        if (((goalMask >> indexEnd) & 1) && (isMove2Valid(movingPiece, indexMid, indexEnd, cells) || ((indexStart == (indexMid + indexEnd) / 2) && isMoveValid(movingPiece, indexEnd, cells))))
+                        {
+                            return true;
+                        }
+                    }
+
+                    // stack, 0/1-range move
+                    for (size_t indexEndLoop = 7 * indexMid + 1; indexEndLoop < 7 * indexMid + Lookup::neighbours[7 * indexMid] + 1; indexEndLoop++)
+                    {
+                        uint64_t indexEnd = Lookup::neighbours[indexEndLoop];
+                        if (((goalMask >> indexEnd) & 1) && (isMoveValid(movingPiece, indexEnd, cells) || (indexStart == indexEnd)))
+                        {
+                            return true;
+                        }
+                    }
+                }
+                // 1-range move
+                else if (((goalMask >> indexMid) & 1) && isMoveValid(movingPiece, indexMid, cells))
                 {
                     return true;
                 }
             }
         }
-        for (int k = 39; k < 45; k++)
+        else
         {
-            if (cells[k] != 0)
+            // 2 range first action
+            for (size_t indexMidLoop = 7 * indexStart + 1; indexMidLoop < 7 * indexStart + Lookup::neighbours2[7 * indexStart] + 1; indexMidLoop++)
             {
-                // If piece is Black and not Wise
-                if ((cells[k] & COLOUR_MASK) == COLOUR_BLACK && (cells[k] & TYPE_MASK) != TYPE_WISE)
+                uint64_t indexMid = Lookup::neighbours2[indexMidLoop];
+                if (isMove2Valid(movingPiece, indexStart, indexMid, cells))
                 {
-                    return true;
+                    // 2-range move
+                    if ((goalMask >> indexMid) & 1)
+                    {
+                        return true;
+                    }
+
+                    // 2-range move, stack or unstack
+                    for (size_t indexEndLoop = 7 * indexMid + 1; indexEndLoop < 7 * indexMid + Lookup::neighbours[7 * indexMid] + 1; indexEndLoop++)
+                    {
+                        uint64_t indexEnd = Lookup::neighbours[indexEndLoop];
+                        if (((goalMask >> indexEnd) & 1) && (isUnstackValid(movingPiece, indexEnd, cells) || isStackValid(movingPiece, indexEnd, cells)))
+                        {
+                            return true;
+                        }
+                    }
                 }
             }
-        }
-        return false;
-    }
-
-    // Returns true if the move leads to a win
-    bool isMoveWin(uint64_t move, const uint8_t cells[45])
-    {
-        size_t indexStart = move & INDEX_MASK;
-        size_t indexEnd = (move >> (2 * INDEX_WIDTH)) & INDEX_MASK;
-        uint8_t movingPiece = cells[indexStart];
-        
-        if ((movingPiece & TYPE_MASK) != TYPE_WISE)
-        {
-            if (((movingPiece & COLOUR_MASK) == COLOUR_WHITE && (indexEnd <= 5)) || ((movingPiece & COLOUR_MASK) == COLOUR_BLACK && (indexEnd >= 39)))
+            // 1-range first action
+            for (size_t indexMidLoop = 7 * indexStart + 1; indexMidLoop < 7 * indexStart + Lookup::neighbours[7 * indexStart] + 1; indexMidLoop++)
             {
-                return true;
+                uint64_t indexMid = Lookup::neighbours[indexMidLoop];
+                // 1-range move, [stack or unstack] optional
+                if (isMoveValid(movingPiece, indexMid, cells))
+                {
+                    // 1-range move, or unstack on the goal row
+                    if ((goalMask >> indexMid) & 1)
+                    {
+                        return true;
+                    }
+
+                    // 1-range move, stack or unstack
+                    for (size_t indexEndLoop = 7 * indexMid + 1; indexEndLoop < 7 * indexMid + Lookup::neighbours[7 * indexMid] + 1; indexEndLoop++)
+                    {
+                        uint64_t indexEnd = Lookup::neighbours[indexEndLoop];
+                        if (((goalMask >> indexEnd) & 1) && (isUnstackValid(movingPiece, indexEnd, cells) || isStackValid(movingPiece, indexEnd, cells)))
+                        {
+                            return true;
+                        }
+                    }
+                }
+                // stack, [1/2-range move] optional
+                else if (isStackValid(movingPiece, indexMid, cells))
+                {
+                    // stack only
+                    if ((goalMask >> indexMid) & 1)
+                    {
+                        return true;
+                    }
+
+                    // stack, 2-range move
+                    for (size_t indexEndLoop = 7 * indexMid + 1; indexEndLoop < 7 * indexMid + Lookup::neighbours2[7 * indexMid] + 1; indexEndLoop++)
+                    {
+                        uint64_t indexEnd = Lookup::neighbours2[indexEndLoop];
+                        if (((goalMask >> indexEnd) & 1) && isMove2Valid(movingPiece, indexMid, indexEnd, cells))
+                        {
+                            return true;
+                        }
+                    }
+
+                    // stack, 1-range move
+                    for (size_t indexEndLoop = 7 * indexMid + 1; indexEndLoop < 7 * indexMid + Lookup::neighbours[7 * indexMid] + 1; indexEndLoop++)
+                    {
+                        uint64_t indexEnd = Lookup::neighbours[indexEndLoop];
+                        if (((goalMask >> indexEnd) & 1) && isMoveValid(movingPiece, indexEnd, cells))
+                        {
+                            return true;
+                        }
+                    }
+                }
             }
         }
         return false;
     }
 
-    // Returns 0 if the winning player is white, 1 if black, 0xFF if no winning player
-    uint8_t getWinningPlayer(const uint8_t cells[45])
+    /* Returns true if the player has a move that wins immediately, without generating the move list.
+    Only the non-Wise pieces standing within 3 rows of the goal row can reach it in one move. */
+    bool hasWinningMove(uint8_t player, const uint8_t cells[45])
     {
-        for (int k = 0; k < 6; k++)
+        uint64_t goalMask = goalMasks[player];
+        // White pieces on rows 1 to 3 (cells 6 to 25), Black pieces on rows 3 to 5 (cells 19 to 38)
+        size_t indexFirst = (player == 0) ? 6 : 19;
+        size_t indexLast = (player == 0) ? 25 : 38;
+        for (size_t index = indexFirst; index <= indexLast; index++)
         {
-            if (cells[k] != 0)
+            uint8_t piece = cells[index];
+            if (piece != 0 && (piece & COLOUR_MASK) == (uint8_t)(player << 1) && (piece & TYPE_MASK) != TYPE_WISE)
             {
-                // If piece is White and not Wise
-                if ((cells[k] & COLOUR_MASK) == COLOUR_WHITE && (cells[k] & TYPE_MASK) != TYPE_WISE)
+                if (_hasPieceWinningMove(index, cells, goalMask))
                 {
-                    return 0U;
-                }
-            }
-        }
-        for (int k = 39; k < 45; k++)
-        {
-            if (cells[k] != 0)
-            {
-                // If piece is Black and not Wise
-                if ((cells[k] & COLOUR_MASK) == COLOUR_BLACK && (cells[k] & TYPE_MASK) != TYPE_WISE)
-                {
-                    return 1U;
+                    return true;
                 }
             }
         }
-        return 0xFFU;
+        return false;
     }
 
     // Returns the list of possible moves for a specific piece
@@ -1054,31 +1246,49 @@ namespace PijersiEngine::Logic
         return moves;
     }
 
+    /* Draws a random move without generating the moves of all the pieces, it is the playout policy of MCTS.
+    A piece of the player is drawn first, then one of its moves (see availablePieceMoves), pieces without moves are rejected and drawn again.
+    The moves are not uniform over the move list: each piece that can move is equally likely. Returns NULL_MOVE if the player cannot move. */
+    uint64_t sampleRandomMove(const uint8_t cells[45], uint8_t currentPlayer)
+    {
+        uint8_t pieceIndices[45];
+        size_t nPieces = 0;
+        for (size_t index = 0; index < 45; index++)
+        {
+            if (cells[index] != 0 && (cells[index] & COLOUR_MASK) == (uint8_t)(currentPlayer << 1))
+            {
+                pieceIndices[nPieces] = index;
+                nPieces++;
+            }
+        }
+
+        array<uint64_t, MAX_PLAYER_MOVES> moves;
+        while (nPieces > 0)
+        {
+            size_t pieceIndex = std::uniform_int_distribution<size_t>(0, nPieces - 1)(RNG::gen);
+            moves[MAX_PLAYER_MOVES - 1] = 0;
+            availablePieceMoves(pieceIndices[pieceIndex], cells, moves);
+            size_t nMoves = moves[MAX_PLAYER_MOVES - 1];
+            if (nMoves > 0)
+            {
+                return moves[std::uniform_int_distribution<size_t>(0, nMoves - 1)(RNG::gen)];
+            }
+            nPieces--;
+            pieceIndices[pieceIndex] = pieceIndices[nPieces];
+        }
+        return NULL_MOVE;
+    }
+
     // Returns whether a source piece can capture a target piece
     constexpr bool canTake(uint8_t source, uint8_t target)
     {
-        uint8_t sourceType = source & TYPE_MASK;
-        uint8_t targetType = target & TYPE_MASK;
-        // Scissors > Paper, Paper > Rock, Rock > Scissors
-        return ((sourceType == TYPE_SCISSORS && targetType == TYPE_PAPER) || (sourceType == TYPE_PAPER && targetType == TYPE_ROCK) || (sourceType == TYPE_ROCK && targetType == TYPE_SCISSORS));
+        return Lookup::pieceInteractions[((source & TOP_MASK) << 8) | target] & INTERACTION_TAKE;
     }
 
     // Returns whether a certain 1-range move is possible
     inline bool isMoveValid(uint8_t movingPiece, uint64_t indexEnd, const uint8_t cells[45])
     {
-        if (cells[indexEnd] != 0)
-        {
-            // If the end piece and the moving piece are the same colour
-            if ((cells[indexEnd] & COLOUR_MASK) == (movingPiece & COLOUR_MASK))
-            {
-                return false;
-            }
-            if (!canTake(movingPiece, cells[indexEnd]))
-            {
-                return false;
-            }
-        }
-        return true;
+        return Lookup::pieceInteractions[((movingPiece & TOP_MASK) << 8) | cells[indexEnd]] & INTERACTION_MOVE;
     }
 
     // Returns whether a certain 2-range move is possible
@@ -1089,55 +1299,19 @@ namespace PijersiEngine::Logic
         {
             return false;
         }
-        if (cells[indexEnd] != 0)
-        {
-            // If the end piece and the moving piece are the same colour
-            if ((cells[indexEnd] & COLOUR_MASK) == (movingPiece & COLOUR_MASK))
-            {
-                return false;
-            }
-            if (!canTake(movingPiece, cells[indexEnd]))
-            {
-                return false;
-            }
-        }
-        return true;
+        return Lookup::pieceInteractions[((movingPiece & TOP_MASK) << 8) | cells[indexEnd]] & INTERACTION_MOVE;
     }
 
     // Returns whether a certain stack action is possible
     inline bool isStackValid(uint8_t movingPiece, uint64_t indexEnd, const uint8_t cells[45])
     {
-        // If the end cell is not empty
-        // If the target piece and the moving piece are the same colour
-        // If the end piece is not a stack
-        if ((cells[indexEnd] != 0) && ((cells[indexEnd] & COLOUR_MASK) == (movingPiece & COLOUR_MASK)) && (cells[indexEnd] < 16))
-        {
-            // If the upper piece is Wise and the target piece is not Wise
-            if ((movingPiece & TYPE_MASK) == TYPE_WISE && (cells[indexEnd] & TYPE_MASK) != TYPE_WISE)
-            {
-                return false;
-            }
-            return true;
-        }
-        return false;
+        return Lookup::pieceInteractions[((movingPiece & TOP_MASK) << 8) | cells[indexEnd]] & INTERACTION_STACK;
     }
 
     // Returns whether a certain unstack action is possible
     inline bool isUnstackValid(uint8_t movingPiece, uint64_t indexEnd, const uint8_t cells[45])
     {
-        if (cells[indexEnd] != 0)
-        {
-            // If the cells are the same colour
-            if ((cells[indexEnd] & COLOUR_MASK) == (movingPiece & COLOUR_MASK))
-            {
-                return false;
-            }
-            if (!canTake(movingPiece, cells[indexEnd]))
-            {
-                return false;
-            }
-        }
-        return true;
+        return Lookup::pieceInteractions[((movingPiece & TOP_MASK) << 8) | cells[indexEnd]] & INTERACTION_UNSTACK;
     }
 
     void countMoves(uint8_t currentPlayer, const uint8_t cells[45], size_t countWhite[45], size_t countBlack[45])
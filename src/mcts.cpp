@@ -1,16 +1,25 @@
+#include <algorithm>
+#include <bit>
 #include <cfloat>
 #include <chrono>
 #include <cmath>
 #include <cstdint>
 #include <iostream>
 #include <ctime>
+#include <random>
+#include <thread>
+#include <utility>
 #include <vector>
 
 #include <omp.h>
 
 #include <alphabeta.hpp>
 #include <logic.hpp>
+#include <lookup.hpp>
 #include <mcts.hpp>
+#include <nnue.hpp>
+#include <options.hpp>
+#include <rng.hpp>
 
 using std::array;
 using std::cout;
@@ -24,194 +33,947 @@ namespace PijersiEngine::MCTS
         return nodeWins/nodeSimulations + 1.414f * sqrtf(logf(totalSimulations) / nodeSimulations);
     }
 
-    uint64_t ponderMCTS(int milliseconds, int simulationsPerRollout, uint8_t cells[45], uint8_t currentPlayer)
+    /* UCT score with RAVE, the value of the child is blended with its RAVE value with the weight beta, which decays from 1 to 0 as the child is visited.
+    A child that was never visited is scored by its RAVE value alone, with the exploration of a single visit. */
+    inline float _UCTRAVE(float nodeWins, float nodeSimulations, float raveWins, float raveSimulations, float totalSimulations)
     {
-        int nThreads = omp_get_max_threads();
-        array<uint64_t, MAX_PLAYER_MOVES> moves = Logic::availablePlayerMoves(currentPlayer, cells);
+        float beta = sqrtf(MCTS_RAVE_EQUIVALENCE / (3.f * nodeSimulations + MCTS_RAVE_EQUIVALENCE));
+        float value = (nodeSimulations > 0) ? nodeWins / nodeSimulations : 0.f;
+        return (1.f - beta) * value + beta * raveWins / raveSimulations + 1.414f * sqrtf(logf(totalSimulations) / std::max(nodeSimulations, 1.f));
+    }
+
+    inline float _PUCT(float nodeValue, float prior, float nodeSimulations, float parentSimulations)
+    {
+        return nodeValue + MCTS_PUCT_EXPLORATION * prior * sqrtf(parentSimulations) / (1.f + nodeSimulations);
+    }
+
+    // Win probability of an evaluation (on the scale of the network outputs)
+    inline float _winProbability(float value)
+    {
+        return 1.f / (1.f + expf(-value * NNUE_SCALE / MCTS_EVALUATION_SCALE));
+    }
+
+    /* Default valueFunction, runs the batched forward of the network (NNUE::Network::forwardBatch).
+    Large batches are split between Options::threads threads, in slices of at least MCTS_EVALUATION_SLICE positions.
+    Falls back to the table evaluation if no network could be loaded. */
+    void _networkValues(const uint8_t positions[][45], const uint8_t players[], size_t n, float values[])
+    {
+        if (!NNUE::network.loaded)
+        {
+            for (size_t k = 0; k < n; k++)
+            {
+                int64_t evaluation = AlphaBeta::evaluatePosition(positions[k]);
+                values[k] = (float)((players[k] == 0) ? evaluation : -evaluation) / NNUE_SCALE;
+            }
+            return;
+        }
+
+        size_t nSlices = std::clamp(n / MCTS_EVALUATION_SLICE, (size_t)1, std::max(Options::threads, (size_t)1));
+        #pragma omp parallel for num_threads(nSlices)
+        for (size_t slice = 0; slice < nSlices; slice++)
+        {
+            size_t begin = n * slice / nSlices;
+            size_t end = n * (slice + 1) / nSlices;
+            NNUE::network.forwardBatch(positions + begin, players + begin, end - begin, values + begin);
+        }
+    }
+
+    ValueFunction valueFunction = _networkValues;
+    PolicyFunction policyFunction = nullptr;
+
+    /* Allocates the children of a node in one block, cells and player are its position. The priors of the children are set by policyFunction.
+    Returns false if another thread is expanding the node, if the node has no moves or if the arena is full. */
+    bool _expand(NodeArena &arena, uint32_t index, const uint8_t cells[45], uint8_t player)
+    {
+        Node &node = arena[index];
+        uint32_t firstChild = NULL_NODE;
+        if (!node.firstChild.compare_exchange_strong(firstChild, EXPANDING_NODE, std::memory_order_relaxed))
+        {
+            return false;
+        }
+
+        // Get a vector of all the available moves for the current player
+        array<uint64_t, MAX_PLAYER_MOVES> moves = Logic::availablePlayerMoves(player, cells);
+        size_t nMoves = moves[MAX_PLAYER_MOVES - 1];
+        // The player to move cannot move and loses
+        if (nMoves == 0)
+        {
+            node.result.store(MCTS_WIN, std::memory_order_relaxed);
+        }
+        uint32_t first = (nMoves > 0) ? arena.allocate(nMoves) : NULL_NODE;
+        if (first == NULL_NODE)
+        {
+            node.firstChild.store(NULL_NODE, std::memory_order_relaxed);
+            return false;
+        }
+        float priors[MAX_PLAYER_MOVES];
+        if (policyFunction)
+        {
+            policyFunction(cells, player, moves.data(), nMoves, priors);
+        }
+        else
+        {
+            std::fill(priors, priors + nMoves, 1.f / nMoves);
+        }
+        for (size_t k = 0; k < nMoves; k++)
+        {
+            Node &child = arena[first + k];
+            child.init(Logic::compressMove(moves[k]));
+            child.prior = (uint16_t)(std::clamp(priors[k], 0.f, 1.f) * MCTS_PRIOR_MAX);
+        }
+        node.nChildren = nMoves;
+        node.firstChild.store(first, std::memory_order_release);
+        return true;
+    }
+
+    // Returns a winning move of the player, NULL_MOVE if there is none
+    uint64_t _winningMove(const uint8_t cells[45], uint8_t player)
+    {
+        array<uint64_t, MAX_PLAYER_MOVES> moves = Logic::availablePlayerMoves(player, cells);
         size_t nMoves = moves[MAX_PLAYER_MOVES - 1];
+        for (size_t k = 0; k < nMoves; k++)
+        {
+            if (Logic::isMoveWin(moves[k], cells))
+            {
+                return moves[k];
+            }
+        }
+        return NULL_MOVE;
+    }
 
-        vector<int> visitsPerThreads(nMoves*nThreads);
+    /* Plays a random game from the position with Logic::sampleRandomMove and returns the winner, player is the player to move.
+    The game ends as soon as the player to move has a winning move, which it is assumed to play, or when it cannot move, which loses.
+    A game longer than Options::mctsRolloutPlies is stopped, and won by White with the probability given by the evaluation.
+    The compact ids of the moves played are added to moves if it is not null, the players alternate from player. */
+    uint8_t _playout(const uint8_t cells[45], uint8_t player, vector<uint16_t> *moves)
+    {
+        // The player who played the last move has won
+        if (Logic::isPositionWin(cells))
+        {
+            return 1 - player;
+        }
 
+        uint8_t newCells[45];
+        Logic::setState(newCells, cells);
+        uint8_t currentPlayer = player;
+        size_t ply = 0;
+        while (true)
+        {
+            if (Logic::hasWinningMove(currentPlayer, newCells))
+            {
+                if (moves != nullptr)
+                {
+                    moves->push_back(Logic::compressMove(_winningMove(newCells, currentPlayer)));
+                }
+                return currentPlayer;
+            }
+            if (Options::mctsRolloutPlies > 0 && ply >= Options::mctsRolloutPlies)
+            {
+                float whiteWinProbability = 1.f / (1.f + expf(-AlphaBeta::evaluatePosition(newCells) / MCTS_EVALUATION_SCALE));
+                return (std::uniform_real_distribution<float>(0.f, 1.f)(RNG::gen) < whiteWinProbability) ? 0 : 1;
+            }
+            uint64_t move = Logic::sampleRandomMove(newCells, currentPlayer);
+            if (move == NULL_MOVE)
+            {
+                return 1 - currentPlayer;
+            }
+            if (moves != nullptr)
+            {
+                moves->push_back(Logic::compressMove(move));
+            }
+            Logic::play(move, newCells);
+            currentPlayer = 1 - currentPlayer;
+            ply++;
+        }
+    }
 
-        if (nMoves > 0)
+    // Plays nSimulations random games from the position (see _playout), returns the number of games lost by player (the player to move)
+    int _rollout(const uint8_t cells[45], uint8_t player, int nSimulations)
+    {
+        int nWins = 0;
+        for (int k = 0; k < nSimulations; k++)
         {
-            #pragma omp parallel for num_threads(nThreads)
-            for (int k = 0; k < nThreads; k++)
+            if (_playout(cells, player, nullptr) != player)
             {
-                Node root(nullptr, NULL_MOVE, currentPlayer);
-                Logic::setState(root.cells, cells);
-                root.expand();
+                nWins++;
+            }
+        }
+        return nWins;
+    }
 
-                auto finish = std::chrono::steady_clock::now() + std::chrono::milliseconds(milliseconds);
+    /* Adds the score of the simulations from the last node of the path to each node of the path, alternating the point of view.
+    The scores are in units of 1 / MCTS_SCORE_UNIT wins, maxScore is the score of winning all the simulations. The visits were already added during the selection. */
+    void _update(NodeArena &arena, const vector<uint32_t> &path, int64_t winScore, int64_t maxScore)
+    {
+        for (size_t k = path.size(); k-- > 0;)
+        {
+            arena[path[k]].score.fetch_add(winScore, std::memory_order_relaxed);
+            winScore = maxScore - winScore;
+        }
+    }
+
+    /* Adds a simulation to the RAVE statistics of the children of the nodes of the path, player is the player to move at the last node.
+    playoutMoves are the moves played from the last node, the players alternating from player.
+    The moves played by each player are marked in stamps (player * Lookup::moveIdCount + move id) with the value stamp, which is new for each simulation.
+    Going up the path, the move of each node is marked for the player who played it before the children of its parent are updated,
+    so that a child counts the moves of its player from its parent down to the end of the playout. */
+    void _updateRAVE(NodeArena &arena, const vector<uint32_t> &path, const vector<uint16_t> &playoutMoves, uint8_t player, uint8_t winner, vector<uint32_t> &stamps, uint32_t stamp)
+    {
+        for (size_t k = 0; k < playoutMoves.size(); k++)
+        {
+            stamps[((player + k) % 2) * Lookup::moveIdCount + playoutMoves[k]] = stamp;
+        }
 
-                Node *current = &root;
-                do
+        for (size_t k = path.size() - 1; k-- > 0;)
+        {
+            // Player to move at path[k]
+            uint8_t nodePlayer = (player + path.size() - 1 - k) % 2;
+            uint32_t *playerStamps = stamps.data() + nodePlayer * Lookup::moveIdCount;
+            playerStamps[arena[path[k + 1]].move] = stamp;
+            Node &node = arena[path[k]];
+            uint32_t firstChild = node.firstChild.load(std::memory_order_acquire);
+            for (uint32_t childIndex = firstChild; childIndex < firstChild + node.nChildren; childIndex++)
+            {
+                if (playerStamps[arena[childIndex].move] == stamp)
                 {
-                    if (current->isLeaf())
+                    RaveStats &stats = arena.raveStats(childIndex);
+                    stats.visits.fetch_add(1, std::memory_order_relaxed);
+                    if (winner == nodePlayer)
                     {
-                        if (current->visits == 0)
-                        {
-                            current->rollout(simulationsPerRollout);
-                            current = &root;
-                        }
-                        else
-                        {
-                            if (!current->isWin())
-                            {
-                                current->expand();
-                                if (current->children.size() > 0)
-                                {
-                                    current = current->children[0];
-                                }
-                            }
-                            else
-                            {
-                                current->rollout(simulationsPerRollout);
-                                current = &root;
-                            }
-                        }
+                        stats.wins.fetch_add(1, std::memory_order_relaxed);
                     }
-                    else
+                }
+            }
+        }
+    }
+
+    // Proves the nodes whose outcome is known from their position: the last move won, or the player to move has a winning move
+    void _setTerminalResult(Node &node, const uint8_t cells[45], uint8_t player)
+    {
+        if (Logic::isPositionWin(cells))
+        {
+            node.result.store(MCTS_WIN, std::memory_order_relaxed);
+        }
+        else if (Logic::hasWinningMove(player, cells))
+        {
+            node.result.store(MCTS_LOSS, std::memory_order_relaxed);
+        }
+    }
+
+    /* Propagates the result of the last node of the path to its ancestors (MCTS-Solver).
+    A node is lost when one of its children is won by the opponent, and won when all of its children are lost by the opponent. */
+    void _solve(NodeArena &arena, const vector<uint32_t> &path)
+    {
+        for (size_t k = path.size() - 1; k > 0; k--)
+        {
+            uint8_t result = arena[path[k]].result.load(std::memory_order_relaxed);
+            Node &parent = arena[path[k - 1]];
+            if (result == MCTS_WIN)
+            {
+                parent.result.store(MCTS_LOSS, std::memory_order_relaxed);
+            }
+            else if (result == MCTS_LOSS)
+            {
+                uint32_t firstChild = parent.firstChild.load(std::memory_order_acquire);
+                for (uint32_t childIndex = firstChild; childIndex < firstChild + parent.nChildren; childIndex++)
+                {
+                    if (arena[childIndex].result.load(std::memory_order_relaxed) != MCTS_LOSS)
                     {
-                        float uctScore = -FLT_MAX;
-                        size_t index = 0;
-                        for (size_t i = 0; i < current->children.size(); i++)
-                        {
-                            if (current->children[i]->visits == 0)
-                            {
-                                index = i;
-                                break;
-                            }
-                            else
-                            {
-                                float childScore = _UCT(current->children[i]->score, current->children[i]->visits, root.visits);
-                                if (childScore > uctScore)
-                                {
-                                    index = i;
-                                    uctScore = childScore;
-                                }
-                            }
-                        }
-                        current = current->children[index];
+                        return;
                     }
-                } while (std::chrono::steady_clock::now() <= finish);
-                for (size_t n = 0; n < nMoves; n++)
-                {
-                    visitsPerThreads[k*nMoves+n] = root.children[n]->visits;
                 }
+                parent.result.store(MCTS_WIN, std::memory_order_relaxed);
+            }
+            else
+            {
+                return;
+            }
+        }
+    }
+
+    /* Returns the child of the node with the best UCT score, children that were never visited first.
+    With RAVE, the UCT score blends in the RAVE value and only the children without any visit or RAVE statistics come first.
+    With PUCT, the best PUCT score, the value of the children that were never visited is the value of the node for their player.
+    A proven win is always selected and proven losses are skipped, the first child is returned if they are all lost. */
+    uint32_t _select(NodeArena &arena, Node &node, uint32_t firstChild, int32_t totalVisits, bool puct, bool rave)
+    {
+        float uctScore = -FLT_MAX;
+        uint32_t selected = firstChild;
+        int32_t nodeVisits = node.visits.load(std::memory_order_relaxed);
+        float unvisitedValue = 1.f - (float)node.score.load(std::memory_order_relaxed) / (MCTS_SCORE_UNIT * std::max(nodeVisits, 1));
+        for (uint32_t childIndex = firstChild; childIndex < firstChild + node.nChildren; childIndex++)
+        {
+            Node &child = arena[childIndex];
+            uint8_t result = child.result.load(std::memory_order_relaxed);
+            if (result == MCTS_WIN)
+            {
+                return childIndex;
+            }
+            if (result == MCTS_LOSS)
+            {
+                continue;
+            }
+            int32_t visits = child.visits.load(std::memory_order_relaxed);
+            float childScore;
+            if (puct)
+            {
+                float value = (visits > 0) ? (float)child.score.load(std::memory_order_relaxed) / (MCTS_SCORE_UNIT * visits) : unvisitedValue;
+                childScore = _PUCT(value, (float)child.prior / MCTS_PRIOR_MAX, visits, nodeVisits);
+            }
+            else if (int32_t raveVisits = rave ? arena.raveStats(childIndex).visits.load(std::memory_order_relaxed) : 0; raveVisits > 0)
+            {
+                childScore = _UCTRAVE((float)child.score.load(std::memory_order_relaxed) / MCTS_SCORE_UNIT, visits, arena.raveStats(childIndex).wins.load(std::memory_order_relaxed), raveVisits, totalVisits);
+            }
+            else if (visits == 0)
+            {
+                return childIndex;
+            }
+            else
+            {
+                childScore = _UCT((float)child.score.load(std::memory_order_relaxed) / MCTS_SCORE_UNIT, visits, totalVisits);
+            }
+            if (childScore > uctScore)
+            {
+                selected = childIndex;
+                uctScore = childScore;
             }
+        }
+        return selected;
+    }
+
+    /* Runs simulations from the root until finishTime, until the root has visitLimit visits, until it is proven or until the arena is full.
+    The tree is shared with the other threads.
+    Each simulation selects a path down to a node visited for the first time, or expands the leaf it reaches if it was visited before,
+    then scores the last node of the path with rollouts, or with its result if it is proven. With RAVE, the moves of the rollouts also update the RAVE statistics along the path.
+    With PUCT, a simulation counts as one visit and the leaf is sent to the queue of the evaluator thread instead of the rollouts,
+    the thread goes on with the next simulation while the virtual loss of the path keeps the other simulations away from it. */
+    void _search(NodeArena &arena, uint32_t rootIndex, const uint8_t cells[45], uint8_t currentPlayer, int simulationsPerRollout, time_point<steady_clock> finishTime, int32_t visitLimit, LeafQueue *queue)
+    {
+        bool puct = queue != nullptr;
+        bool rave = !puct && arena.hasRAVE();
+        if (puct)
+        {
+            simulationsPerRollout = 1;
+        }
 
+        // Position of the current node, and the nodes and moves (with their pieces) from the root
+        uint8_t currentCells[45];
+        Logic::setState(currentCells, cells);
+        vector<uint32_t> path;
+        vector<uint64_t> pathMoves;
+        // Moves of the playouts and their marks for RAVE (see _updateRAVE)
+        vector<uint16_t> playoutMoves;
+        vector<uint32_t> stamps(rave ? 2 * Lookup::moveIdCount : 0, 0);
+        uint32_t stamp = 0;
+        Node &root = arena[rootIndex];
 
-            vector<int> visitsPerNode(nMoves);
-            #pragma omp parallel for
-            for (int k = 0; k < nThreads; k++)
+        while (steady_clock::now() <= finishTime && root.visits.load(std::memory_order_relaxed) < visitLimit && root.result.load(std::memory_order_relaxed) == MCTS_UNKNOWN && !arena.full())
+        {
+            path.push_back(rootIndex);
+            root.visits.fetch_add(simulationsPerRollout, std::memory_order_relaxed);
+            uint8_t player = currentPlayer;
+            while (true)
             {
-                for (size_t n = 0; n < nMoves; n++)
+                Node &current = arena[path.back()];
+                if (current.result.load(std::memory_order_relaxed) != MCTS_UNKNOWN)
+                {
+                    break;
+                }
+                uint32_t firstChild = current.firstChild.load(std::memory_order_acquire);
+                if (firstChild >= EXPANDING_NODE)
+                {
+                    // A leaf is expanded on its second visit, it is scored by the rollouts if another thread is expanding it or if it has no moves
+                    if (path.size() == 1 || !_expand(arena, path.back(), currentCells, player))
+                    {
+                        break;
+                    }
+                    firstChild = current.firstChild.load(std::memory_order_relaxed);
+                }
+
+                uint32_t childIndex = _select(arena, current, firstChild, root.visits.load(std::memory_order_relaxed), puct, rave);
+                uint64_t move = Logic::attachPieces(Logic::decompressMove(arena[childIndex].move), currentCells);
+                Logic::play(move, currentCells);
+                player = 1 - player;
+                path.push_back(childIndex);
+                pathMoves.push_back(move);
+
+                // Virtual loss: the visits count as losses until the wins are added, which steers the other threads to other children
+                if (arena[childIndex].visits.fetch_add(simulationsPerRollout, std::memory_order_relaxed) == 0)
                 {
-                    visitsPerNode[n] += visitsPerThreads[k*nMoves+n];
+                    _setTerminalResult(arena[childIndex], currentCells, player);
+                    break;
                 }
             }
 
-            // Get child with max visits from root
-            int maxVisits = 0;
-            size_t index = 0;
-            for (size_t k = 0; k < nMoves; k++)
+            Node &leaf = arena[path.back()];
+            uint8_t result = leaf.result.load(std::memory_order_relaxed);
+            int64_t maxScore = (int64_t)simulationsPerRollout * MCTS_SCORE_UNIT;
+            if (result != MCTS_UNKNOWN)
+            {
+                _update(arena, path, (result == MCTS_WIN) ? maxScore : 0, maxScore);
+                _solve(arena, path);
+            }
+            else if (puct)
             {
-                if (visitsPerNode[k] > maxVisits)
+                queue->push(currentCells, player, path);
+            }
+            else if (rave)
+            {
+                // The playouts are scored one by one for their RAVE statistics
+                int nWins = 0;
+                for (int k = 0; k < simulationsPerRollout; k++)
                 {
-                    index = k;
-                    maxVisits = visitsPerNode[k];
+                    playoutMoves.clear();
+                    uint8_t winner = _playout(currentCells, player, &playoutMoves);
+                    if (winner != player)
+                    {
+                        nWins++;
+                    }
+                    if (++stamp == 0)
+                    {
+                        std::fill(stamps.begin(), stamps.end(), 0);
+                        stamp = 1;
+                    }
+                    _updateRAVE(arena, path, playoutMoves, player, winner, stamps, stamp);
                 }
+                _update(arena, path, nWins * MCTS_SCORE_UNIT, maxScore);
+            }
+            else
+            {
+                _update(arena, path, _rollout(currentCells, player, simulationsPerRollout) * MCTS_SCORE_UNIT, maxScore);
             }
 
-            // Select the corresponding move
-            return moves[index];
+            // Go back to the root position
+            while (!pathMoves.empty())
+            {
+                Logic::unplay(pathMoves.back(), currentCells);
+                pathMoves.pop_back();
+            }
+            path.clear();
         }
-        return NULL_MOVE;
     }
 
-    Node::Node(Node *newParent, const uint64_t &newMove, uint8_t newPlayer) : move(newMove)
+    // Evaluates the leaves of the queue in batches with valueFunction and adds their values to their paths, until the queue is closed and empty
+    void _evaluateLeaves(NodeArena &arena, LeafQueue &queue)
     {
-        parent = newParent;
-        player = newPlayer;
-        if (parent != nullptr)
+        vector<LeafRequest> batch;
+        vector<uint8_t> positions;
+        vector<uint8_t> players;
+        vector<float> values;
+        while (queue.pop(batch))
         {
-            Logic::setState(cells, parent->cells);
-            Logic::playManual(move, cells);
+            size_t n = batch.size();
+            if (n == 0)
+            {
+                continue;
+            }
+            positions.resize(n * 45);
+            players.resize(n);
+            values.resize(n);
+            for (size_t k = 0; k < n; k++)
+            {
+                Logic::setState(positions.data() + k * 45, batch[k].cells);
+                players[k] = batch[k].player;
+            }
+            valueFunction(reinterpret_cast<const uint8_t (*)[45]>(positions.data()), players.data(), n, values.data());
+            for (size_t k = 0; k < n; k++)
+            {
+                // The node is won by the player who played its move when the player to move loses
+                int64_t winScore = std::llround((1.f - _winProbability(values[k])) * MCTS_SCORE_UNIT);
+                _update(arena, batch[k].path, winScore, MCTS_SCORE_UNIT);
+            }
         }
-
-        children.reserve(256);
     }
 
-    Node::~Node()
+    // Returns the child to play: a proven win, or else the most visited child that is not a proven loss
+    uint32_t _bestChild(NodeArena &arena, Node &node)
     {
-        for (size_t k = 0; k < children.size(); k++)
+        int32_t maxVisits = -1;
+        uint32_t bestChild = node.firstChild;
+        for (uint32_t childIndex = node.firstChild; childIndex < node.firstChild + node.nChildren; childIndex++)
         {
-            if (children[k] != nullptr)
+            Node &child = arena[childIndex];
+            if (child.result == MCTS_WIN)
+            {
+                return childIndex;
+            }
+            int32_t visits = (child.result == MCTS_LOSS) ? -1 : child.visits.load(std::memory_order_relaxed);
+            if (visits > maxVisits)
             {
-                delete children[k];
+                bestChild = childIndex;
+                maxVisits = visits;
             }
         }
+        return bestChild;
     }
 
-    bool Node::isLeaf()
+    /* Prints the search info in UGI format: the visits of this search and their rate, the visits of the root,
+    the score of the best move (its win rate on the scale of the evaluation) and the principal variation along the best children. */
+    void _printInfo(NodeArena &arena, uint32_t rootIndex, const uint8_t cells[45], int32_t startVisits, time_point<steady_clock> startTime)
     {
-        return (children.size() == 0);
+        Node &root = arena[rootIndex];
+        int32_t visits = root.visits;
+        int64_t nodes = visits - startVisits;
+        int64_t duration = std::chrono::duration_cast<std::chrono::milliseconds>(steady_clock::now() - startTime).count();
+        cout << "info time " << duration << " nodes " << nodes << " nps " << nodes * 1000 / std::max(duration, (int64_t)1) << " visits " << visits;
+
+        if (!root.isLeaf())
+        {
+            Node &best = arena[_bestChild(arena, root)];
+            int64_t score;
+            if (best.result != MCTS_UNKNOWN)
+            {
+                score = (best.result == MCTS_WIN) ? MAX_SCORE : -MAX_SCORE;
+            }
+            else
+            {
+                float winRate = std::clamp((float)best.score / (MCTS_SCORE_UNIT * std::max((int32_t)best.visits, 1)), 1e-4f, 1.f - 1e-4f);
+                score = (int64_t)(MCTS_EVALUATION_SCALE * logf(winRate / (1.f - winRate)));
+            }
+            cout << " score " << score;
+        }
+
+        uint8_t pvCells[45];
+        Logic::setState(pvCells, cells);
+        cout << " pv";
+        Node *node = &root;
+        for (size_t ply = 0; ply < MCTS_PV_LENGTH && !node->isLeaf(); ply++)
+        {
+            node = &arena[_bestChild(arena, *node)];
+            uint64_t move = Logic::decompressMove(node->move);
+            cout << " " << Logic::moveToString(move, pvCells);
+            Logic::play(move, pvCells);
+        }
+        cout << endl;
     }
 
-    bool Node::isWin()
+    /* Searches the position with MCTS until finishTime, until maxVisits more visits of the root or until the root is proven, and returns the best move.
+    The tree of the previous search is reused if it holds the position. Prints an info line every MCTS_INFO_INTERVAL milliseconds if Options::verbose is set. */
+    uint64_t ponderMCTS(time_point<steady_clock> finishTime, uint64_t maxVisits, int simulationsPerRollout, const uint8_t cells[45], uint8_t currentPlayer)
     {
-        return Logic::isPositionWin(cells);
+        time_point<steady_clock> startTime = steady_clock::now();
+
+        // Keep the part of the previous tree that is still relevant, if it was built by the same mode
+        if (tree.puct != Options::mctsPUCT)
+        {
+            tree.clear();
+            tree.puct = Options::mctsPUCT;
+        }
+        tree.setLimit(Options::mctsMaxNodes);
+        tree.setRAVE(!Options::mctsPUCT && Options::mctsRAVE);
+        tree.setRoot(cells, currentPlayer);
+        if (tree.root().isLeaf() && !_expand(tree.arena(), tree.rootIndex, cells, currentPlayer))
+        {
+            return NULL_MOVE;
+        }
+
+        // Immediate wins are proven before the search, which then stops at once
+        Node &root = tree.root();
+        for (uint32_t childIndex = root.firstChild; childIndex < root.firstChild + root.nChildren; childIndex++)
+        {
+            if (Logic::isMoveWin(Logic::decompressMove(tree.arena()[childIndex].move), cells))
+            {
+                tree.arena()[childIndex].result = MCTS_WIN;
+                root.result = MCTS_LOSS;
+            }
+        }
+
+        if (Options::mctsPUCT && !NNUE::ensureLoaded() && Options::verbose)
+        {
+            cout << "info string could not load the network, the leaves are evaluated with the table evaluation" << endl;
+        }
+
+        int32_t startVisits = root.visits;
+        int32_t visitLimit = (int32_t)std::min(maxVisits, (uint64_t)(INT32_MAX - startVisits)) + startVisits;
+
+        /* The search runs in rounds, which end to print the info or to prune the tree when it is full.
+        The arena and the root move at each pruning. */
+        time_point<steady_clock> lastPrintTime = startTime;
+        while (true)
+        {
+            NodeArena &arena = tree.arena();
+            uint32_t rootIndex = tree.rootIndex;
+            time_point<steady_clock> roundFinishTime = Options::verbose ? std::min(finishTime, lastPrintTime + std::chrono::milliseconds(MCTS_INFO_INTERVAL)) : finishTime;
+            if (Options::mctsPUCT)
+            {
+                // The selection threads feed the evaluator thread, which finishes the queued leaves after them
+                LeafQueue queue;
+                queue.open(Options::mctsBatchSize);
+                std::thread evaluator(_evaluateLeaves, std::ref(arena), std::ref(queue));
+                #pragma omp parallel num_threads(Options::threads)
+                {
+                    _search(arena, rootIndex, cells, currentPlayer, simulationsPerRollout, roundFinishTime, visitLimit, &queue);
+                }
+                queue.close();
+                evaluator.join();
+            }
+            else
+            {
+                #pragma omp parallel num_threads(Options::threads)
+                {
+                    _search(arena, rootIndex, cells, currentPlayer, simulationsPerRollout, roundFinishTime, visitLimit, nullptr);
+                }
+            }
+
+            // Prunings also end rounds, so the info is only printed at the interval and at the end
+            time_point<steady_clock> now = steady_clock::now();
+            bool finished = now > finishTime || tree.root().visits >= visitLimit || tree.root().result != MCTS_UNKNOWN;
+            if (Options::verbose && (finished || now >= lastPrintTime + std::chrono::milliseconds(MCTS_INFO_INTERVAL)))
+            {
+                _printInfo(arena, rootIndex, cells, startVisits, startTime);
+                lastPrintTime = now;
+            }
+            if (finished)
+            {
+                break;
+            }
+            if (arena.full())
+            {
+                tree.prune();
+            }
+        }
+
+        // Select the corresponding move
+        return Logic::decompressMove(tree.arena()[_bestChild(tree.arena(), tree.root())].move);
     }
 
-    void Node::update(int winCount, int visitCount)
+    Tree tree;
+
+    // Returns the node of the position in the first 2 plies of the tree, NULL_NODE if it is not there
+    uint32_t Tree::_find(const uint8_t cells[45], uint8_t player)
     {
-        visits += visitCount;
-        score += winCount;
-        if (parent != nullptr)
+        NodeArena &nodes = arena();
+        uint8_t newCells[45];
+        Logic::setState(newCells, rootCells);
+        if (player == rootPlayer && std::equal(cells, cells + 45, rootCells))
         {
-            parent->update(visitCount - winCount, visitCount);
+            return rootIndex;
+        }
+
+        Node &node = root();
+        for (uint32_t childIndex = node.firstChild; !node.isLeaf() && childIndex < node.firstChild + node.nChildren; childIndex++)
+        {
+            Node &child = nodes[childIndex];
+            uint64_t move = Logic::attachPieces(Logic::decompressMove(child.move), newCells);
+            Logic::play(move, newCells);
+            if (player != rootPlayer && std::equal(cells, cells + 45, newCells))
+            {
+                return childIndex;
+            }
+            for (uint32_t grandChildIndex = child.firstChild; player == rootPlayer && !child.isLeaf() && grandChildIndex < child.firstChild + child.nChildren; grandChildIndex++)
+            {
+                uint64_t reply = Logic::attachPieces(Logic::decompressMove(nodes[grandChildIndex].move), newCells);
+                Logic::play(reply, newCells);
+                bool found = std::equal(cells, cells + 45, newCells);
+                Logic::unplay(reply, newCells);
+                if (found)
+                {
+                    return grandChildIndex;
+                }
+            }
+            Logic::unplay(move, newCells);
         }
+        return NULL_NODE;
     }
 
-    void Node::rollout(int nSimulations)
+    /* Copies the subtree of the node to the other arena, which becomes the current one, and releases the old tree.
+    Only the children of the nodes with at least minVisits visits are copied, the other nodes become leaves.
+    The nodes whose children do not fit the other arena also become leaves. */
+    void Tree::_copy(uint32_t newRootIndex, int32_t minVisits)
     {
-        uint8_t newCells[45];
-        int nWins = 0;
-        for (int k = 0; k < nSimulations; k++)
+        NodeArena &from = arena();
+        NodeArena &to = arenas[1 - current];
+        to.clear();
+
+        // Pairs of nodes (old index, new index) whose children remain to be copied
+        vector<std::pair<uint32_t, uint32_t>> stack;
+        uint32_t copiedRootIndex = to.allocate(1);
+        stack.emplace_back(newRootIndex, copiedRootIndex);
+        Node &oldRoot = from[newRootIndex];
+        Node &newRoot = to[copiedRootIndex];
+        newRoot.init(COMPACT_NULL_MOVE);
+        newRoot.visits.store(oldRoot.visits.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        newRoot.score.store(oldRoot.score.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        newRoot.result.store(oldRoot.result.load(std::memory_order_relaxed), std::memory_order_relaxed);
+
+        while (!stack.empty())
         {
-            Logic::setState(newCells, cells);
-            uint8_t currentPlayer = player;
-            while (true)
+            auto [oldIndex, newIndex] = stack.back();
+            stack.pop_back();
+            Node &oldNode = from[oldIndex];
+            if (oldNode.isLeaf() || oldNode.visits.load(std::memory_order_relaxed) < minVisits)
             {
-                uint64_t move = Logic::searchRandom(newCells, currentPlayer);
-                size_t indexEnd = (move >> 16) & 0x000000FF;
-                currentPlayer = 1 - currentPlayer;
-                if ((currentPlayer == 1 && (indexEnd <= 5)) || (currentPlayer == 0 && (indexEnd >= 39)))
+                continue;
+            }
+            uint32_t first = to.allocate(oldNode.nChildren);
+            if (first == NULL_NODE)
+            {
+                continue;
+            }
+            for (uint32_t k = 0; k < oldNode.nChildren; k++)
+            {
+                Node &oldChild = from[oldNode.firstChild + k];
+                Node &newChild = to[first + k];
+                newChild.init(oldChild.move);
+                newChild.visits.store(oldChild.visits.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                newChild.score.store(oldChild.score.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                newChild.result.store(oldChild.result.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                newChild.prior = oldChild.prior;
+                if (from.hasRAVE() && to.hasRAVE())
                 {
-                    break;
+                    to.raveStats(first + k).visits.store(from.raveStats(oldNode.firstChild + k).visits.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                    to.raveStats(first + k).wins.store(from.raveStats(oldNode.firstChild + k).wins.load(std::memory_order_relaxed), std::memory_order_relaxed);
                 }
-                Logic::playManual(move, newCells);
+                stack.emplace_back(oldNode.firstChild + k, first + k);
+            }
+            Node &newNode = to[newIndex];
+            newNode.nChildren = oldNode.nChildren;
+            newNode.firstChild.store(first, std::memory_order_relaxed);
+        }
+
+        from.clear();
+        from.release(to.size());
+        current = 1 - current;
+        rootIndex = copiedRootIndex;
+    }
+
+    /* Returns the visit threshold of _copy: copying the subtree of the node with the children of the nodes that have at least that many visits
+    takes at most maxNodes nodes, 0 if the whole subtree fits. A node never has more visits than its parent, so these nodes are all connected to the root.
+    The threshold is a power of 2. */
+    int32_t Tree::_visitThreshold(uint32_t subtreeRootIndex, size_t maxNodes)
+    {
+        // Number of children of the expanded nodes by bit width of their visits
+        size_t costs[33] = {};
+        NodeArena &nodes = arena();
+        vector<uint32_t> stack = {subtreeRootIndex};
+        while (!stack.empty())
+        {
+            Node &node = nodes[stack.back()];
+            stack.pop_back();
+            if (node.isLeaf())
+            {
+                continue;
             }
-            if (currentPlayer == player)
+            costs[std::bit_width((uint32_t)node.visits.load(std::memory_order_relaxed))] += node.nChildren;
+            for (uint32_t childIndex = node.firstChild; childIndex < node.firstChild + node.nChildren; childIndex++)
             {
-                nWins++;
+                stack.push_back(childIndex);
             }
         }
-        update(nWins, nSimulations);
+
+        // Keep the most visited nodes first
+        size_t total = 1;
+        size_t width = 32;
+        while (width > 0 && total + costs[width] <= maxNodes)
+        {
+            total += costs[width];
+            width--;
+        }
+        return (width == 0) ? 0 : (width >= 31) ? INT32_MAX : (1 << width);
     }
 
-    void Node::expand()
+    // Halves the size of the tree at most by turning its least visited nodes into leaves
+    void Tree::prune()
     {
-        // Get a vector of all the available moves for the current player
-        array<uint64_t, MAX_PLAYER_MOVES> moves = Logic::availablePlayerMoves(player, cells);
-        size_t nMoves = moves[MAX_PLAYER_MOVES - 1];
-        if (nMoves > 0)
+        _copy(rootIndex, _visitThreshold(rootIndex, arena().size() / 2));
+    }
+
+    void Tree::setLimit(size_t maxNodes)
+    {
+        // The root and its children must always fit
+        maxNodes = std::max(maxNodes, (size_t)MCTS_CHUNK_SIZE);
+        arenas[0].setLimit(maxNodes);
+        arenas[1].setLimit(maxNodes);
+    }
+
+    // Keeps RAVE statistics next to the nodes of both arenas or frees them
+    void Tree::setRAVE(bool enabled)
+    {
+        arenas[0].setRAVE(enabled);
+        arenas[1].setRAVE(enabled);
+    }
+
+    // Sets the root of the tree to the position, keeping its subtree if the tree holds it. Returns true if the tree was kept.
+    bool Tree::setRoot(const uint8_t cells[45], uint8_t player)
+    {
+        uint32_t newRootIndex = (rootIndex != NULL_NODE) ? _find(cells, player) : NULL_NODE;
+        if (newRootIndex == NULL_NODE)
+        {
+            clear();
+            rootIndex = arena().allocate(1);
+            root().init(COMPACT_NULL_MOVE);
+        }
+        else if (newRootIndex != rootIndex)
+        {
+            // The limit may have been lowered since the subtree was searched
+            _copy(newRootIndex, _visitThreshold(newRootIndex, arenas[1 - current].capacity()));
+        }
+        Logic::setState(rootCells, cells);
+        rootPlayer = player;
+        return newRootIndex != NULL_NODE;
+    }
+
+    // Releases the whole tree
+    void Tree::clear()
+    {
+        arenas[0].clear();
+        arenas[1].clear();
+        rootIndex = NULL_NODE;
+    }
+
+    NodeArena::NodeArena() : chunks(new std::atomic<Node *>[MCTS_MAX_CHUNKS]), raveChunks(new std::atomic<RaveStats *>[MCTS_MAX_CHUNKS])
+    {
+        for (size_t k = 0; k < MCTS_MAX_CHUNKS; k++)
+        {
+            chunks[k].store(nullptr, std::memory_order_relaxed);
+            raveChunks[k].store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    NodeArena::~NodeArena()
+    {
+        for (size_t k = 0; k < MCTS_MAX_CHUNKS; k++)
+        {
+            delete[] chunks[k].load(std::memory_order_relaxed);
+            delete[] raveChunks[k].load(std::memory_order_relaxed);
+        }
+    }
+
+    // Frees the chunks that are not needed to hold keptNodes nodes, the arena must be empty or hold at most keptNodes nodes
+    void NodeArena::release(size_t keptNodes)
+    {
+        for (size_t k = (keptNodes + MCTS_CHUNK_SIZE - 1) >> MCTS_CHUNK_WIDTH; k < MCTS_MAX_CHUNKS; k++)
+        {
+            delete[] chunks[k].exchange(nullptr, std::memory_order_relaxed);
+            delete[] raveChunks[k].exchange(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    /* Adds RAVE statistics to the chunks of nodes, the nodes that already exist start with none, or frees them.
+    Must not be called during a search. */
+    void NodeArena::setRAVE(bool enabled)
+    {
+        rave = enabled;
+        for (size_t k = 0; k < MCTS_MAX_CHUNKS; k++)
         {
-            for (size_t k = 0; k < nMoves; k++)
+            if (!enabled)
+            {
+                delete[] raveChunks[k].exchange(nullptr, std::memory_order_relaxed);
+            }
+            else if (chunks[k].load(std::memory_order_relaxed) != nullptr && raveChunks[k].load(std::memory_order_relaxed) == nullptr)
             {
-                children.push_back(new Node(this, moves[k], 1-player));
+                raveChunks[k].store(new RaveStats[MCTS_CHUNK_SIZE], std::memory_order_relaxed);
             }
         }
     }
-}
\ No newline at end of file
+
+    /* Returns the index of a block of nNodes contiguous nodes, NULL_NODE if the arena is full.
+    The block starts at the next chunk if the current one is too small to hold it, the chunk is created by the first thread that needs it. */
+    uint32_t NodeArena::allocate(uint32_t nNodes)
+    {
+        uint32_t index;
+        uint32_t start = used.load(std::memory_order_relaxed);
+        do
+        {
+            index = start;
+            uint64_t chunkEnd = ((uint64_t)(index >> MCTS_CHUNK_WIDTH) + 1) << MCTS_CHUNK_WIDTH;
+            if (index + nNodes > chunkEnd)
+            {
+                index = chunkEnd;
+            }
+            if ((uint64_t)index + nNodes > limit)
+            {
+                return NULL_NODE;
+            }
+        } while (!used.compare_exchange_weak(start, index + nNodes, std::memory_order_relaxed));
+
+        std::atomic<Node *> &chunk = chunks[index >> MCTS_CHUNK_WIDTH];
+        if (chunk.load(std::memory_order_acquire) == nullptr)
+        {
+            std::lock_guard<std::mutex> lock(chunkMutex);
+            if (chunk.load(std::memory_order_relaxed) == nullptr)
+            {
+                // The RAVE chunk is published with the chunk of nodes
+                if (rave)
+                {
+                    raveChunks[index >> MCTS_CHUNK_WIDTH].store(new RaveStats[MCTS_CHUNK_SIZE], std::memory_order_relaxed);
+                }
+                chunk.store(new Node[MCTS_CHUNK_SIZE], std::memory_order_release);
+            }
+        }
+        if (rave)
+        {
+            for (uint32_t k = index; k < index + nNodes; k++)
+            {
+                raveStats(k).visits.store(0, std::memory_order_relaxed);
+                raveStats(k).wins.store(0, std::memory_order_relaxed);
+            }
+        }
+        return index;
+    }
+
+    void Node::init(uint16_t newMove)
+    {
+        firstChild.store(NULL_NODE, std::memory_order_relaxed);
+        nChildren = 0;
+        move = newMove;
+        visits.store(0, std::memory_order_relaxed);
+        score.store(0, std::memory_order_relaxed);
+        result.store(MCTS_UNKNOWN, std::memory_order_relaxed);
+        prior = 0;
+    }
+
+    bool Node::isLeaf() const
+    {
+        return firstChild.load(std::memory_order_acquire) >= EXPANDING_NODE;
+    }
+
+    void LeafQueue::open(size_t newBatchSize)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        batchSize = std::max(newBatchSize, (size_t)1);
+        requests.clear();
+        requests.reserve(batchSize * MCTS_QUEUE_BATCHES);
+        closed = false;
+    }
+
+    // Lets the evaluator empty the queue then stop
+    void LeafQueue::close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+        }
+        notEmpty.notify_all();
+    }
+
+    void LeafQueue::push(const uint8_t cells[45], uint8_t player, const vector<uint32_t> &path)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this] { return requests.size() < batchSize * MCTS_QUEUE_BATCHES; });
+        LeafRequest &request = requests.emplace_back();
+        Logic::setState(request.cells, cells);
+        request.player = player;
+        request.path = path;
+        if (requests.size() >= batchSize)
+        {
+            notEmpty.notify_one();
+        }
+    }
+
+    // Moves the queued leaves to batch, waits for a full batch for at most MCTS_BATCH_WAIT microseconds. Returns false once the queue is closed and empty.
+    bool LeafQueue::pop(vector<LeafRequest> &batch)
+    {
+        batch.clear();
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait_for(lock, std::chrono::microseconds(MCTS_BATCH_WAIT), [this] { return requests.size() >= batchSize || closed; });
+        if (requests.empty())
+        {
+            return !closed;
+        }
+        std::swap(batch, requests);
+        lock.unlock();
+        notFull.notify_all();
+        return true;
+    }
+}
@@ -0,0 +1,160 @@
+#include <array>
+#include <bit>
+#include <cstdint>
+
+#include <logic.hpp>
+#include <lookup.hpp>
+#include <mobility.hpp>
+
+using std::array;
+
+namespace PijersiEngine::Mobility
+{
+    // Returns for each cell the mask of the cells that are at most range 1-range steps away
+    constexpr array<uint64_t, 45> _rangeMasks(size_t range)
+    {
+        array<uint64_t, 45> masks{};
+        for (size_t index = 0; index < 45; index++)
+        {
+            uint64_t mask = 1ULL << index;
+            for (size_t step = 0; step < range; step++)
+            {
+                uint64_t grown = mask;
+                for (size_t cell = 0; cell < 45; cell++)
+                {
+                    if ((mask >> cell) & 1)
+                    {
+                        for (size_t k = 7 * cell + 1; k < 7 * cell + Lookup::neighbours[7 * cell] + 1; k++)
+                        {
+                            grown |= 1ULL << Lookup::neighbours[k];
+                        }
+                    }
+                }
+                mask = grown;
+            }
+            masks[index] = mask;
+        }
+        return masks;
+    }
+
+    /* The moves of a piece read the cells up to 3 steps away (a stack followed by a 2-range move, or a 2-range move followed by an unstack).
+    When a cell changes, only the pieces inside its mask need to be recomputed. */
+    constexpr array<uint64_t, 45> influenceMasks = _rangeMasks(3);
+
+    // Builds the whole map from scratch
+    void MobilityMap::init(const uint8_t cells[45])
+    {
+        occupied[0] = 0;
+        occupied[1] = 0;
+        for (size_t index = 0; index < 45; index++)
+        {
+            pieceMoves[index] = 0;
+            pieceReach[index] = 0;
+            if (cells[index] != 0)
+            {
+                occupied[(cells[index] & COLOUR_MASK) >> 1] |= 1ULL << index;
+            }
+        }
+        _update(occupied[0] | occupied[1], cells);
+    }
+
+    // Plays the move on the board and updates the map
+    void MobilityMap::play(uint64_t move, uint8_t cells[45])
+    {
+        uint64_t indexStart = move & INDEX_MASK;
+        uint64_t indexMid = (move >> INDEX_WIDTH) & INDEX_MASK;
+        uint64_t indexEnd = (move >> (2 * INDEX_WIDTH)) & INDEX_MASK;
+        uint64_t changedCells = (1ULL << indexStart) | (1ULL << indexEnd) | ((indexMid <= 44) ? (1ULL << indexMid) : 0);
+
+        Logic::play(move, cells);
+        _update(changedCells, cells);
+    }
+
+    // Undoes the move on the board and updates the map, the move must carry its pieces (see Logic::attachPieces)
+    void MobilityMap::unplay(uint64_t move, uint8_t cells[45])
+    {
+        uint64_t indexStart = move & INDEX_MASK;
+        uint64_t indexMid = (move >> INDEX_WIDTH) & INDEX_MASK;
+        uint64_t indexEnd = (move >> (2 * INDEX_WIDTH)) & INDEX_MASK;
+        uint64_t changedCells = (1ULL << indexStart) | (1ULL << indexEnd) | ((indexMid <= 44) ? (1ULL << indexMid) : 0);
+
+        Logic::unplay(move, cells);
+        _update(changedCells, cells);
+    }
+
+    // Returns the cells where the player's pieces can land
+    uint64_t MobilityMap::attackedCells(uint8_t player) const
+    {
+        return attacked[player];
+    }
+
+    // Returns the cells of the player's pieces that the opponent can capture
+    uint64_t MobilityMap::threatenedPieces(uint8_t player) const
+    {
+        return occupied[player] & attacked[1 - player];
+    }
+
+    // Returns the number of moves available to the player
+    uint64_t MobilityMap::mobility(uint8_t player) const
+    {
+        return moves[player];
+    }
+
+    // Returns the number of moves of the piece standing on the cell
+    uint16_t MobilityMap::pieceMobility(size_t index) const
+    {
+        return pieceMoves[index];
+    }
+
+    // Recomputes the pieces that can be affected by the changed cells, then the totals
+    void MobilityMap::_update(uint64_t changedCells, const uint8_t cells[45])
+    {
+        uint64_t affectedCells = 0;
+        for (uint64_t remaining = changedCells; remaining != 0; remaining &= remaining - 1)
+        {
+            size_t index = std::countr_zero(remaining);
+            occupied[0] &= ~(1ULL << index);
+            occupied[1] &= ~(1ULL << index);
+            if (cells[index] != 0)
+            {
+                occupied[(cells[index] & COLOUR_MASK) >> 1] |= 1ULL << index;
+            }
+            affectedCells |= influenceMasks[index];
+        }
+
+        // Empty cells only need to be cleared, and only the changed ones can have become empty
+        affectedCells &= occupied[0] | occupied[1] | changedCells;
+        for (uint64_t remaining = affectedCells; remaining != 0; remaining &= remaining - 1)
+        {
+            _updatePiece(std::countr_zero(remaining), cells);
+        }
+
+        for (size_t player = 0; player < 2; player++)
+        {
+            moves[player] = 0;
+            attacked[player] = 0;
+            for (uint64_t remaining = occupied[player]; remaining != 0; remaining &= remaining - 1)
+            {
+                size_t index = std::countr_zero(remaining);
+                moves[player] += pieceMoves[index];
+                attacked[player] |= pieceReach[index];
+            }
+        }
+    }
+
+    // Recomputes the moves and the reach of a single cell
+    void MobilityMap::_updatePiece(size_t index, const uint8_t cells[45])
+    {
+        if (cells[index] == 0)
+        {
+            pieceMoves[index] = 0;
+            pieceReach[index] = 0;
+        }
+        else
+        {
+            uint64_t reach = 0;
+            pieceMoves[index] = Logic::pieceMobility(index, cells, reach);
+            pieceReach[index] = reach;
+        }
+    }
+}
@@ -9,6 +9,7 @@
 #include <npy.hpp>
 
 #include <nn.hpp>
+#include <nnue.hpp>
 #include <rng.hpp>
 #include <weights.hpp>
 
@@ -120,7 +121,7 @@ namespace PijersiEngine::NN
                     }
                     if (cells[44 - k] >= 16)
                     {
-                        switch (cells[k] & 224)
+                        switch (cells[44 - k] & 224)
                         {
                         case 32:
                             input.insert(k * 16 + 8, 0) = 1;
@@ -219,6 +220,14 @@ namespace PijersiEngine::NN
         bias4 = bias4_t::Map(Weights::dense_3_b, N_OUTPUTS_4, 1);
     }
 
+    // Writes the weights in the NNUE file format, the matrices are column-major so they already have its layout
+    bool Network::save(const std::string &fileName)
+    {
+        const float *weights[4] = {weights1.data(), weights2.data(), weights3.data(), weights4.data()};
+        const float *biases[4] = {bias1.data(), bias2.data(), bias3.data(), bias4.data()};
+        return NNUE::saveFloatLayers(fileName, weights, biases);
+    }
+
     Trainer::Trainer(int newBatchSize)
     {
         batchSize = newBatchSize;
@@ -310,4 +319,11 @@ namespace PijersiEngine::NN
         weights3 -= learningRate * weightsError3;
         weights4 -= learningRate * weightsError4;
     }
+    // Writes the trained weights in the NNUE file format, see Network::save
+    bool Trainer::save(const std::string &fileName)
+    {
+        const float *weights[4] = {weights1.data(), weights2.data(), weights3.data(), weights4.data()};
+        const float *biases[4] = {bias1.data(), bias2.data(), bias3.data(), bias4.data()};
+        return NNUE::saveFloatLayers(fileName, weights, biases);
+    }
 }
\ No newline at end of file
@@ -0,0 +1,721 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <alphabeta.hpp>
+#include <logic.hpp>
+#include <nnue.hpp>
+#include <options.hpp>
+#include <simd.hpp>
+
+namespace PijersiEngine::NNUE
+{
+    Network network;
+
+    static_assert(sizeof(FileHeader) <= NNUE_FILE_ALIGNMENT);
+
+    constexpr uint32_t layerInputs[4] = {NNUE_INPUTS, NNUE_HIDDEN_1, NNUE_HIDDEN_2, NNUE_HIDDEN_3};
+    constexpr uint32_t layerOutputs[4] = {NNUE_HIDDEN_1, NNUE_HIDDEN_2, NNUE_HIDDEN_3, 1};
+
+    // 64-bit FNV-1a hash
+    uint64_t checksum(const uint8_t *data, size_t size)
+    {
+        uint64_t hash = 0xCBF29CE484222325ULL;
+        for (size_t k = 0; k < size; k++)
+        {
+            hash = (hash ^ data[k]) * 0x100000001B3ULL;
+        }
+        return hash;
+    }
+
+    FileHeader _makeHeader(uint32_t quantization, const uint8_t *payload, size_t payloadSize)
+    {
+        FileHeader header = {};
+        header.magic = NNUE_FILE_MAGIC;
+        header.version = NNUE_FILE_VERSION;
+        header.quantization = quantization;
+        header.nLayers = 4;
+        std::copy(layerInputs, layerInputs + 4, header.inputs);
+        std::copy(layerOutputs, layerOutputs + 4, header.outputs);
+        header.weightScale = NNUE_WEIGHT_SCALE;
+        header.activationShift1 = NNUE_ACTIVATION_SHIFT_1;
+        header.activationScale2 = NNUE_ACTIVATION_SCALE_2;
+        header.multiplierShift = NNUE_MULTIPLIER_SHIFT;
+        header.payloadSize = payloadSize;
+        header.checksum = checksum(payload, payloadSize);
+        return header;
+    }
+
+    bool _writeFile(const std::string &fileName, uint32_t quantization, const uint8_t *payload, size_t payloadSize)
+    {
+        std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+        if (!file)
+        {
+            return false;
+        }
+        uint8_t header[NNUE_FILE_ALIGNMENT] = {};
+        FileHeader fileHeader = _makeHeader(quantization, payload, payloadSize);
+        std::memcpy(header, &fileHeader, sizeof(FileHeader));
+        file.write((const char *)header, NNUE_FILE_ALIGNMENT);
+        file.write((const char *)payload, payloadSize);
+        return (bool)file;
+    }
+
+    size_t _floatPayloadSize()
+    {
+        size_t size = 0;
+        for (size_t layer = 0; layer < 4; layer++)
+        {
+            size += (layerInputs[layer] + 1) * layerOutputs[layer] * sizeof(float);
+        }
+        return size;
+    }
+
+    /* Writes float layers in the layout of the NN module (weights[input * outputs + output]).
+    This is the format written by the trainer, the engine quantizes it when loading. */
+    bool saveFloatLayers(const std::string &fileName, const float *weights[4], const float *biases[4])
+    {
+        std::vector<uint8_t> payload(_floatPayloadSize());
+        uint8_t *position = payload.data();
+        for (size_t layer = 0; layer < 4; layer++)
+        {
+            size_t nWeights = layerInputs[layer] * layerOutputs[layer];
+            std::memcpy(position, weights[layer], nWeights * sizeof(float));
+            position += nWeights * sizeof(float);
+            std::memcpy(position, biases[layer], layerOutputs[layer] * sizeof(float));
+            position += layerOutputs[layer] * sizeof(float);
+        }
+        return _writeFile(fileName, NNUE_QUANTIZATION_FLOAT32, payload.data(), payload.size());
+    }
+
+    MappedFile::~MappedFile()
+    {
+        close();
+    }
+
+    bool MappedFile::open(const std::string &fileName)
+    {
+        close();
+#ifdef _WIN32
+        HANDLE newFileHandle = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (newFileHandle == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(newFileHandle, &fileSize) || fileSize.QuadPart == 0)
+        {
+            CloseHandle(newFileHandle);
+            return false;
+        }
+        HANDLE newMappingHandle = CreateFileMappingA(newFileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (newMappingHandle == nullptr)
+        {
+            CloseHandle(newFileHandle);
+            return false;
+        }
+        void *view = MapViewOfFile(newMappingHandle, FILE_MAP_READ, 0, 0, 0);
+        if (view == nullptr)
+        {
+            CloseHandle(newMappingHandle);
+            CloseHandle(newFileHandle);
+            return false;
+        }
+        fileHandle = newFileHandle;
+        mappingHandle = newMappingHandle;
+        data = (const uint8_t *)view;
+        size = (size_t)fileSize.QuadPart;
+#else
+        int fileDescriptor = ::open(fileName.c_str(), O_RDONLY);
+        if (fileDescriptor < 0)
+        {
+            return false;
+        }
+        struct stat fileStat;
+        if (fstat(fileDescriptor, &fileStat) != 0 || fileStat.st_size == 0)
+        {
+            ::close(fileDescriptor);
+            return false;
+        }
+        void *view = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+        // The mapping stays valid after the descriptor is closed
+        ::close(fileDescriptor);
+        if (view == MAP_FAILED)
+        {
+            return false;
+        }
+        data = (const uint8_t *)view;
+        size = fileStat.st_size;
+#endif
+        return true;
+    }
+
+    void MappedFile::close()
+    {
+        if (data == nullptr)
+        {
+            return;
+        }
+#ifdef _WIN32
+        UnmapViewOfFile(data);
+        CloseHandle(mappingHandle);
+        CloseHandle(fileHandle);
+        fileHandle = nullptr;
+        mappingHandle = nullptr;
+#else
+        munmap((void *)data, size);
+#endif
+        data = nullptr;
+        size = 0;
+    }
+
+    // Copies float layers in the layout of the NN module, the hidden layers are transposed so that each output reads contiguous inputs
+    void _setFloatLayers(Network &network, const float *weights[4], const float *biases[4])
+    {
+        std::copy(weights[0], weights[0] + NNUE_INPUTS * NNUE_HIDDEN_1, network.weights1);
+        std::copy(biases[0], biases[0] + NNUE_HIDDEN_1, network.bias1);
+        for (size_t output = 0; output < NNUE_HIDDEN_2; output++)
+        {
+            for (size_t input = 0; input < NNUE_HIDDEN_1; input++)
+            {
+                network.weights2[output * NNUE_HIDDEN_1 + input] = weights[1][input * NNUE_HIDDEN_2 + output];
+            }
+        }
+        std::copy(biases[1], biases[1] + NNUE_HIDDEN_2, network.bias2);
+        for (size_t output = 0; output < NNUE_HIDDEN_3; output++)
+        {
+            for (size_t input = 0; input < NNUE_HIDDEN_2; input++)
+            {
+                network.weights3[output * NNUE_HIDDEN_2 + input] = weights[2][input * NNUE_HIDDEN_3 + output];
+            }
+        }
+        std::copy(biases[2], biases[2] + NNUE_HIDDEN_3, network.bias3);
+        std::copy(weights[3], weights[3] + NNUE_HIDDEN_3, network.weights4);
+        network.bias4 = biases[3][0];
+    }
+
+    // Checks that a mapped file is a weight file that this engine can use
+    bool _checkHeader(const MappedFile &file, FileHeader &header)
+    {
+        if (file.size < NNUE_FILE_ALIGNMENT)
+        {
+            return false;
+        }
+        std::memcpy(&header, file.data, sizeof(FileHeader));
+        if (header.magic != NNUE_FILE_MAGIC || header.version != NNUE_FILE_VERSION || header.nLayers != 4)
+        {
+            return false;
+        }
+        if (!std::equal(layerInputs, layerInputs + 4, header.inputs) || !std::equal(layerOutputs, layerOutputs + 4, header.outputs))
+        {
+            return false;
+        }
+        if (header.payloadSize != file.size - NNUE_FILE_ALIGNMENT)
+        {
+            return false;
+        }
+        if (header.quantization == NNUE_QUANTIZATION_FLOAT32)
+        {
+            if (header.payloadSize != _floatPayloadSize())
+            {
+                return false;
+            }
+        }
+        else if (header.quantization == NNUE_QUANTIZATION_INT16_INT8)
+        {
+            if (header.payloadSize != sizeof(QuantizedLayers) || header.weightScale != NNUE_WEIGHT_SCALE || header.activationShift1 != NNUE_ACTIVATION_SHIFT_1 || header.activationScale2 != NNUE_ACTIVATION_SCALE_2 || header.multiplierShift != NNUE_MULTIPLIER_SHIFT)
+            {
+                return false;
+            }
+        }
+        else
+        {
+            return false;
+        }
+        return header.checksum == checksum(file.data + NNUE_FILE_ALIGNMENT, header.payloadSize);
+    }
+
+    /* Returns the path of the default network: NNUE_DEFAULT_FILE in the directory of the executable, or in its parent directory
+    (the binaries of the repository are in build/). Falls back to the working directory if neither exists. */
+    std::string defaultFileName()
+    {
+        std::filesystem::path directory;
+#ifdef _WIN32
+        char path[MAX_PATH];
+        DWORD length = GetModuleFileNameA(NULL, path, MAX_PATH);
+        directory = std::filesystem::path(std::string(path, length)).parent_path();
+#else
+        std::error_code error;
+        directory = std::filesystem::read_symlink("/proc/self/exe", error).parent_path();
+#endif
+        for (const std::filesystem::path &candidate : {directory / NNUE_DEFAULT_FILE, directory.parent_path() / NNUE_DEFAULT_FILE})
+        {
+            std::error_code error;
+            if (!directory.empty() && std::filesystem::exists(candidate, error))
+            {
+                return candidate.string();
+            }
+        }
+        return NNUE_DEFAULT_FILE;
+    }
+
+    /* Loads a weight file, an empty file name loads the default network (see defaultFileName).
+    Float files are quantized, quantized files are used in place from the mapping.
+    Returns false and keeps the current network if the file can't be used. */
+    bool Network::load(const std::string &newFileName)
+    {
+        MappedFile newFile;
+        FileHeader header;
+        if (!newFile.open(newFileName.empty() ? defaultFileName() : newFileName) || !_checkHeader(newFile, header))
+        {
+            return false;
+        }
+        if (header.quantization == NNUE_QUANTIZATION_FLOAT32)
+        {
+            const float *weights[4];
+            const float *biases[4];
+            const float *position = (const float *)(newFile.data + NNUE_FILE_ALIGNMENT);
+            for (size_t layer = 0; layer < 4; layer++)
+            {
+                weights[layer] = position;
+                position += layerInputs[layer] * layerOutputs[layer];
+                biases[layer] = position;
+                position += layerOutputs[layer];
+            }
+            _setFloatLayers(*this, weights, biases);
+            quantize();
+            layers = &ownedLayers;
+            hasFloatLayers = true;
+            file.close();
+        }
+        else
+        {
+            file.close();
+            std::swap(file.data, newFile.data);
+            std::swap(file.size, newFile.size);
+#ifdef _WIN32
+            std::swap(file.fileHandle, newFile.fileHandle);
+            std::swap(file.mappingHandle, newFile.mappingHandle);
+#endif
+            layers = (const QuantizedLayers *)(file.data + NNUE_FILE_ALIGNMENT);
+            hasFloatLayers = false;
+        }
+        fileName = newFileName;
+        loaded = true;
+        return true;
+    }
+
+    // Loads Options::evalFile, or else the default network, if no network is loaded yet. Returns false if there is still no network.
+    bool ensureLoaded()
+    {
+        return network.loaded || network.load(Options::evalFile) || network.load("");
+    }
+
+    // Writes the network, a float file can only be written if the network was loaded from float layers
+    bool Network::save(const std::string &newFileName, uint32_t quantization) const
+    {
+        if (quantization == NNUE_QUANTIZATION_INT16_INT8)
+        {
+            return _writeFile(newFileName, quantization, (const uint8_t *)layers, sizeof(QuantizedLayers));
+        }
+        if (quantization != NNUE_QUANTIZATION_FLOAT32 || !hasFloatLayers)
+        {
+            return false;
+        }
+        std::vector<float> weights2NN(NNUE_HIDDEN_1 * NNUE_HIDDEN_2);
+        for (size_t output = 0; output < NNUE_HIDDEN_2; output++)
+        {
+            for (size_t input = 0; input < NNUE_HIDDEN_1; input++)
+            {
+                weights2NN[input * NNUE_HIDDEN_2 + output] = weights2[output * NNUE_HIDDEN_1 + input];
+            }
+        }
+        std::vector<float> weights3NN(NNUE_HIDDEN_2 * NNUE_HIDDEN_3);
+        for (size_t output = 0; output < NNUE_HIDDEN_3; output++)
+        {
+            for (size_t input = 0; input < NNUE_HIDDEN_2; input++)
+            {
+                weights3NN[input * NNUE_HIDDEN_3 + output] = weights3[output * NNUE_HIDDEN_2 + input];
+            }
+        }
+        const float *weights[4] = {weights1, weights2NN.data(), weights3NN.data(), weights4};
+        const float *biases[4] = {bias1, bias2, bias3, &bias4};
+        return saveFloatLayers(newFileName, weights, biases);
+    }
+
+    // Rounds a float to the nearest integer of a signed type, saturating at its bounds
+    template <class T>
+    T _quantize(float value)
+    {
+        float rounded = std::round(value);
+        rounded = std::clamp(rounded, (float)std::numeric_limits<T>::min(), (float)std::numeric_limits<T>::max());
+        return (T)rounded;
+    }
+
+    /* Quantizes layer 2 with one int8 scale per output row, so that the largest weight of each row is 127.
+    The multipliers convert the int32 sums from the input activation scale to the output activation scale. */
+    void _quantizeLayer(const float *weights, const float *bias, size_t nInputs, size_t nOutputs, float inputScale, float outputScale, int8_t *weightsQuantized, int32_t *biasQuantized, int32_t *multipliers)
+    {
+        for (size_t output = 0; output < nOutputs; output++)
+        {
+            float maximum = 0.f;
+            for (size_t input = 0; input < nInputs; input++)
+            {
+                maximum = std::max(maximum, std::abs(weights[output * nInputs + input]));
+            }
+            float weightScale = (maximum > 0.f) ? 127.f / maximum : 1.f;
+            for (size_t input = 0; input < nInputs; input++)
+            {
+                weightsQuantized[output * nInputs + input] = _quantize<int8_t>(weights[output * nInputs + input] * weightScale);
+            }
+            biasQuantized[output] = _quantize<int32_t>(bias[output] * inputScale * weightScale);
+            multipliers[output] = _quantize<int32_t>(outputScale / (inputScale * weightScale) * (1 << NNUE_MULTIPLIER_SHIFT));
+        }
+    }
+
+    // Builds the quantized layers from the float layers
+    void Network::quantize()
+    {
+        for (size_t k = 0; k < NNUE_INPUTS * NNUE_HIDDEN_1; k++)
+        {
+            ownedLayers.weights1[k] = _quantize<int16_t>(weights1[k] * NNUE_WEIGHT_SCALE);
+        }
+        for (size_t k = 0; k < NNUE_HIDDEN_1; k++)
+        {
+            ownedLayers.bias1[k] = _quantize<int16_t>(bias1[k] * NNUE_WEIGHT_SCALE);
+        }
+
+        _quantizeLayer(weights2, bias2, NNUE_HIDDEN_1, NNUE_HIDDEN_2, NNUE_ACTIVATION_SCALE_1, NNUE_ACTIVATION_SCALE_2, ownedLayers.weights2, ownedLayers.bias2, ownedLayers.multipliers2);
+
+        for (size_t output = 0; output < NNUE_HIDDEN_3; output++)
+        {
+            float maximum = 0.f;
+            for (size_t input = 0; input < NNUE_HIDDEN_2; input++)
+            {
+                maximum = std::max(maximum, std::abs(weights3[output * NNUE_HIDDEN_2 + input]));
+            }
+            float weightScale = (maximum > 0.f) ? 32767.f / maximum : 1.f;
+            for (size_t input = 0; input < NNUE_HIDDEN_2; input++)
+            {
+                ownedLayers.weights3[output * NNUE_HIDDEN_2 + input] = _quantize<int16_t>(weights3[output * NNUE_HIDDEN_2 + input] * weightScale);
+            }
+            ownedLayers.bias3[output] = _quantize<int32_t>(bias3[output] * NNUE_ACTIVATION_SCALE_2 * weightScale);
+            ownedLayers.scales3[output] = 1.f / (NNUE_ACTIVATION_SCALE_2 * weightScale);
+        }
+        std::copy(weights4, weights4 + NNUE_HIDDEN_3, ownedLayers.weights4);
+        ownedLayers.bias4 = bias4;
+    }
+
+    // Runs the layers after the accumulator, returns the evaluation from the point of view of the accumulator's player
+    float Network::propagate(const float accumulator[NNUE_HIDDEN_1]) const
+    {
+        float input1[NNUE_HIDDEN_1];
+        for (size_t k = 0; k < NNUE_HIDDEN_1; k++)
+        {
+            input1[k] = std::max(accumulator[k], 0.f);
+        }
+
+        float input2[NNUE_HIDDEN_2];
+        for (size_t output = 0; output < NNUE_HIDDEN_2; output++)
+        {
+            float sum = bias2[output];
+            for (size_t input = 0; input < NNUE_HIDDEN_1; input++)
+            {
+                sum += weights2[output * NNUE_HIDDEN_1 + input] * input1[input];
+            }
+            input2[output] = std::max(sum, 0.f);
+        }
+
+        float input3[NNUE_HIDDEN_3];
+        for (size_t output = 0; output < NNUE_HIDDEN_3; output++)
+        {
+            float sum = bias3[output];
+            for (size_t input = 0; input < NNUE_HIDDEN_2; input++)
+            {
+                sum += weights3[output * NNUE_HIDDEN_2 + input] * input2[input];
+            }
+            input3[output] = std::max(sum, 0.f);
+        }
+
+        float sum = bias4;
+        for (size_t input = 0; input < NNUE_HIDDEN_3; input++)
+        {
+            sum += weights4[input] * input3[input];
+        }
+        return sum;
+    }
+
+    // Applies the requantization multiplier to an int32 sum and clips it to the int8 activation range
+    inline uint8_t _clippedRelu(int32_t sum, int32_t multiplier)
+    {
+        int64_t scaled = ((int64_t)sum * multiplier + (1LL << (NNUE_MULTIPLIER_SHIFT - 1))) >> NNUE_MULTIPLIER_SHIFT;
+        return (uint8_t)std::clamp<int64_t>(scaled, 0, NNUE_ACTIVATION_MAX);
+    }
+
+    // Integer version of propagate, layers 2 and 3 run on the SIMD kernels
+    float Network::propagateQuantized(const int16_t accumulator[NNUE_HIDDEN_1]) const
+    {
+        alignas(64) uint8_t input1[NNUE_HIDDEN_1];
+        for (size_t k = 0; k < NNUE_HIDDEN_1; k++)
+        {
+            input1[k] = (uint8_t)std::clamp(accumulator[k] >> NNUE_ACTIVATION_SHIFT_1, 0, NNUE_ACTIVATION_MAX);
+        }
+
+        int32_t sums2[NNUE_HIDDEN_2];
+        SIMD::affine(layers->weights2, input1, NNUE_HIDDEN_1, NNUE_HIDDEN_2, sums2);
+        alignas(64) uint8_t input2[NNUE_HIDDEN_2];
+        for (size_t k = 0; k < NNUE_HIDDEN_2; k++)
+        {
+            input2[k] = _clippedRelu(sums2[k] + layers->bias2[k], layers->multipliers2[k]);
+        }
+
+        int32_t sums3[NNUE_HIDDEN_3];
+        SIMD::affine16(layers->weights3, input2, NNUE_HIDDEN_2, NNUE_HIDDEN_3, sums3);
+        float sum = layers->bias4;
+        for (size_t k = 0; k < NNUE_HIDDEN_3; k++)
+        {
+            sum += layers->weights4[k] * (std::max(sums3[k] + layers->bias3[k], 0) * layers->scales3[k]);
+        }
+        return sum;
+    }
+
+    // Evaluates a position from scratch with the float layers, from the point of view of the current player
+    float Network::forward(const uint8_t cells[45], uint8_t currentPlayer) const
+    {
+        float accumulator[NNUE_HIDDEN_1];
+        std::copy(bias1, bias1 + NNUE_HIDDEN_1, accumulator);
+        for (size_t index = 0; index < 45; index++)
+        {
+            size_t features[2];
+            size_t nFeatures = pieceFeatures(cells[index], index, currentPlayer, features);
+            for (size_t n = 0; n < nFeatures; n++)
+            {
+                const float *column = weights1 + features[n] * NNUE_HIDDEN_1;
+                for (size_t k = 0; k < NNUE_HIDDEN_1; k++)
+                {
+                    accumulator[k] += column[k];
+                }
+            }
+        }
+        return propagate(accumulator);
+    }
+
+    // Evaluates a position from scratch with the quantized layers, from the point of view of the current player
+    float Network::forwardQuantized(const uint8_t cells[45], uint8_t currentPlayer) const
+    {
+        Accumulator accumulator;
+        accumulator.refresh(cells);
+        return propagateQuantized(accumulator.values[currentPlayer]);
+    }
+
+    /* Evaluates n positions from scratch with the quantized layers, values[k] is the evaluation of positions[k] from the point of view of players[k].
+    Only the accumulator of the player to move is computed, then layers 2 and 3 are matrix-matrix products over the whole batch (SIMD::affineBatch).
+    The values are the same as those of forwardQuantized. */
+    void Network::forwardBatch(const uint8_t positions[][45], const uint8_t players[], size_t n, float values[]) const
+    {
+        if (n == 0)
+        {
+            return;
+        }
+        std::vector<uint8_t> input1(n * NNUE_HIDDEN_1);
+        for (size_t b = 0; b < n; b++)
+        {
+            alignas(64) int16_t accumulator[NNUE_HIDDEN_1];
+            Accumulator::refresh(positions[b], players[b], accumulator);
+            for (size_t k = 0; k < NNUE_HIDDEN_1; k++)
+            {
+                input1[b * NNUE_HIDDEN_1 + k] = (uint8_t)std::clamp(accumulator[k] >> NNUE_ACTIVATION_SHIFT_1, 0, NNUE_ACTIVATION_MAX);
+            }
+        }
+
+        std::vector<int32_t> sums2(n * NNUE_HIDDEN_2);
+        SIMD::affineBatch(layers->weights2, input1.data(), NNUE_HIDDEN_1, NNUE_HIDDEN_2, n, sums2.data());
+        std::vector<uint8_t> input2(n * NNUE_HIDDEN_2);
+        for (size_t b = 0; b < n; b++)
+        {
+            for (size_t k = 0; k < NNUE_HIDDEN_2; k++)
+            {
+                input2[b * NNUE_HIDDEN_2 + k] = _clippedRelu(sums2[b * NNUE_HIDDEN_2 + k] + layers->bias2[k], layers->multipliers2[k]);
+            }
+        }
+
+        std::vector<int32_t> sums3(n * NNUE_HIDDEN_3);
+        SIMD::affine16Batch(layers->weights3, input2.data(), NNUE_HIDDEN_2, NNUE_HIDDEN_3, n, sums3.data());
+        for (size_t b = 0; b < n; b++)
+        {
+            float sum = layers->bias4;
+            for (size_t k = 0; k < NNUE_HIDDEN_3; k++)
+            {
+                sum += layers->weights4[k] * (std::max(sums3[b * NNUE_HIDDEN_3 + k] + layers->bias3[k], 0) * layers->scales3[k]);
+            }
+            values[b] = sum;
+        }
+    }
+
+    // Index of a half piece in its 8 feature slots: type, then +4 for black
+    constexpr size_t _halfPieceSlot(uint8_t halfPiece)
+    {
+        return ((halfPiece & TYPE_MASK) >> 2) | ((halfPiece & COLOUR_MASK) << 1);
+    }
+
+    /* Writes the features of a piece standing on a cell, returns their number (0 to 2).
+    Features are cell * 16 + slot, with slots 0-7 for the top piece and 8-15 for the bottom piece.
+    Black sees the board rotated (cell 44 - index) with the colours swapped, so both perspectives share the same weights. */
+    size_t pieceFeatures(uint8_t piece, size_t index, uint8_t perspective, size_t features[2])
+    {
+        if (piece == 0)
+        {
+            return 0;
+        }
+        size_t cell = (perspective == 0) ? index : 44 - index;
+        size_t colourSwap = perspective << 2;
+        features[0] = cell * 16 + (_halfPieceSlot(piece & TOP_MASK) ^ colourSwap);
+        if (piece >= 16)
+        {
+            features[1] = cell * 16 + 8 + (_halfPieceSlot(piece >> HALF_PIECE_WIDTH) ^ colourSwap);
+            return 2;
+        }
+        return 1;
+    }
+
+    // Recomputes both accumulators from the board
+    void Accumulator::refresh(const uint8_t cells[45])
+    {
+        refresh(cells, 0, values[0]);
+        refresh(cells, 1, values[1]);
+    }
+
+    // Computes the accumulator of one perspective from the board
+    void Accumulator::refresh(const uint8_t cells[45], uint8_t perspective, int16_t accumulator[NNUE_HIDDEN_1])
+    {
+        std::copy(network.layers->bias1, network.layers->bias1 + NNUE_HIDDEN_1, accumulator);
+        for (size_t index = 0; index < 45; index++)
+        {
+            size_t features[2];
+            size_t nFeatures = pieceFeatures(cells[index], index, perspective, features);
+            for (size_t n = 0; n < nFeatures; n++)
+            {
+                const int16_t *column = network.layers->weights1 + features[n] * NNUE_HIDDEN_1;
+                for (size_t k = 0; k < NNUE_HIDDEN_1; k++)
+                {
+                    accumulator[k] += column[k];
+                }
+            }
+        }
+    }
+
+    // Computes the accumulators after a move from the accumulators before it, only the features of the cells of the move change
+    void Accumulator::update(const Accumulator &previous, uint64_t move, const uint8_t previousCells[45], const uint8_t cells[45])
+    {
+        size_t indexStart = move & INDEX_MASK;
+        size_t indexMid = (move >> INDEX_WIDTH) & INDEX_MASK;
+        size_t indexEnd = (move >> (2 * INDEX_WIDTH)) & INDEX_MASK;
+
+        // The cells of a move are not always distinct
+        size_t changedCells[3] = {indexStart, 0, 0};
+        size_t nChangedCells = 1;
+        if (indexMid <= 44 && indexMid != indexStart)
+        {
+            changedCells[nChangedCells] = indexMid;
+            nChangedCells++;
+        }
+        if (indexEnd != indexStart && indexEnd != indexMid)
+        {
+            changedCells[nChangedCells] = indexEnd;
+            nChangedCells++;
+        }
+
+        for (uint8_t perspective = 0; perspective < 2; perspective++)
+        {
+            size_t removed[NNUE_MAX_CHANGES];
+            size_t added[NNUE_MAX_CHANGES];
+            size_t nRemoved = 0;
+            size_t nAdded = 0;
+            for (size_t n = 0; n < nChangedCells; n++)
+            {
+                size_t index = changedCells[n];
+                if (previousCells[index] != cells[index])
+                {
+                    nRemoved += pieceFeatures(previousCells[index], index, perspective, removed + nRemoved);
+                    nAdded += pieceFeatures(cells[index], index, perspective, added + nAdded);
+                }
+            }
+
+            int16_t *accumulator = values[perspective];
+            std::copy(previous.values[perspective], previous.values[perspective] + NNUE_HIDDEN_1, accumulator);
+            for (size_t n = 0; n < nRemoved; n++)
+            {
+                const int16_t *column = network.layers->weights1 + removed[n] * NNUE_HIDDEN_1;
+                for (size_t k = 0; k < NNUE_HIDDEN_1; k++)
+                {
+                    accumulator[k] -= column[k];
+                }
+            }
+            for (size_t n = 0; n < nAdded; n++)
+            {
+                const int16_t *column = network.layers->weights1 + added[n] * NNUE_HIDDEN_1;
+                for (size_t k = 0; k < NNUE_HIDDEN_1; k++)
+                {
+                    accumulator[k] += column[k];
+                }
+            }
+        }
+    }
+
+    // Sets the root position, this is the only full computation of the accumulators
+    void Evaluator::init(const uint8_t cells[45])
+    {
+        ply = 0;
+        accumulators[0].refresh(cells);
+    }
+
+    // Updates the accumulators after a move, previousCells is the board before the move and cells the board after it
+    void Evaluator::play(uint64_t move, const uint8_t previousCells[45], const uint8_t cells[45])
+    {
+        accumulators[ply + 1].update(accumulators[ply], move, previousCells, cells);
+        ply++;
+    }
+
+    // Goes back to the accumulators before the last move
+    void Evaluator::unplay()
+    {
+        ply--;
+    }
+
+    // Evaluates the current position from the point of view of the current player
+    int64_t Evaluator::evaluate(uint8_t currentPlayer) const
+    {
+        return (int64_t)(network.propagateQuantized(accumulators[ply].values[currentPlayer]) * NNUE_SCALE);
+    }
+
+    // Evaluates the position after a move without keeping it, from the point of view of the player who plays next
+    int64_t Evaluator::evaluateMove(uint64_t move, const uint8_t cells[45], uint8_t currentPlayer)
+    {
+        if (Logic::isMoveWin(move, cells))
+        {
+            return -MAX_SCORE;
+        }
+
+        uint8_t newCells[45];
+        Logic::setState(newCells, cells);
+        Logic::play(move, newCells);
+
+        accumulators[ply + 1].update(accumulators[ply], move, cells, newCells);
+        return (int64_t)(network.propagateQuantized(accumulators[ply + 1].values[currentPlayer]) * NNUE_SCALE);
+    }
+}
@@ -5,4 +5,14 @@ namespace PijersiEngine::Options
     size_t threads = 8;
     bool verbose = true;
     bool openingBook = true;
+    bool nnue = false;
+    std::string evalFile = "";
+    size_t evalCacheSize = 4;
+    std::string evalParamFile = "";
+    std::string engine = "alphabeta";
+    size_t mctsRolloutPlies = 64;
+    bool mctsPUCT = false;
+    bool mctsRAVE = false;
+    size_t mctsBatchSize = 32;
+    size_t mctsMaxNodes = 1 << 23;
 }
\ No newline at end of file
@@ -0,0 +1,438 @@
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include <lookup.hpp>
+#include <simd.hpp>
+
+// The vector kernels are compiled with target attributes, so the rest of the engine keeps the baseline instruction set
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_X86
+#include <immintrin.h>
+#endif
+
+using std::array;
+
+namespace PijersiEngine::SIMD
+{
+    enum Operation
+    {
+        SUM,
+        SUM_STORE,
+        XOR
+    };
+
+    // Associates a piece to the offset of its row in a (piece, cell) table, offset = pieceToIndex[piece] * 45
+    constexpr array<int32_t, 256> _generatePieceOffsets()
+    {
+        array<int32_t, 256> offsets{};
+        for (size_t piece = 0; piece < 256; piece++)
+        {
+            offsets[piece] = Lookup::pieceToIndex[piece] * 45;
+        }
+        return offsets;
+    }
+
+    constexpr array<int32_t, 256> pieceOffsets = _generatePieceOffsets();
+
+    // Reference kernel, one table read per cell
+    template <Operation operation>
+    int64_t _gatherScalar(const int64_t *table, const uint8_t cells[45], int64_t *values)
+    {
+        int64_t result = 0;
+        for (size_t k = 0; k < 45; k++)
+        {
+            int64_t value = table[pieceOffsets[cells[k]] + k];
+            if constexpr (operation == XOR)
+            {
+                result ^= value;
+            }
+            else
+            {
+                result += value;
+            }
+            if constexpr (operation == SUM_STORE)
+            {
+                values[k] = value;
+            }
+        }
+        return result;
+    }
+
+    // Reference integer dense layer
+    template <class Weight>
+    void _affineScalar(const Weight *weights, const uint8_t *inputs, size_t nInputs, size_t nOutputs, int32_t *outputs)
+    {
+        for (size_t output = 0; output < nOutputs; output++)
+        {
+            int32_t sum = 0;
+            for (size_t input = 0; input < nInputs; input++)
+            {
+                sum += inputs[input] * weights[output * nInputs + input];
+            }
+            outputs[output] = sum;
+        }
+    }
+
+    // Batched layer without tiles, runs the kernel of a single input vector on each vector of the batch
+    template <class Weight, void (*kernel)(const Weight *, const uint8_t *, size_t, size_t, int32_t *)>
+    void _affineBatchRows(const Weight *weights, const uint8_t *inputs, size_t nInputs, size_t nOutputs, size_t nBatch, int32_t *outputs)
+    {
+        for (size_t b = 0; b < nBatch; b++)
+        {
+            kernel(weights, inputs + b * nInputs, nInputs, nOutputs, outputs + b * nOutputs);
+        }
+    }
+
+#ifdef SIMD_X86
+    // 4 cells per step: the row offsets are gathered first, then the 64-bit values. Cell 44 is done separately.
+    template <Operation operation>
+    __attribute__((target("avx2")))
+    int64_t _gatherAVX2(const int64_t *table, const uint8_t cells[45], int64_t *values)
+    {
+        const long long *base = reinterpret_cast<const long long *>(table);
+        __m256i accumulator = _mm256_setzero_si256();
+        __m128i cellIndices = _mm_setr_epi32(0, 1, 2, 3);
+        for (size_t k = 0; k < 44; k += 4)
+        {
+            int32_t word;
+            std::memcpy(&word, cells + k, 4);
+            __m128i pieces = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(word));
+            __m128i offsets = _mm_add_epi32(_mm_i32gather_epi32(pieceOffsets.data(), pieces, 4), cellIndices);
+            __m256i gathered = _mm256_i32gather_epi64(base, offsets, 8);
+            if constexpr (operation == XOR)
+            {
+                accumulator = _mm256_xor_si256(accumulator, gathered);
+            }
+            else
+            {
+                accumulator = _mm256_add_epi64(accumulator, gathered);
+            }
+            if constexpr (operation == SUM_STORE)
+            {
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(values + k), gathered);
+            }
+            cellIndices = _mm_add_epi32(cellIndices, _mm_set1_epi32(4));
+        }
+
+        alignas(32) int64_t lanes[4];
+        _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), accumulator);
+        int64_t last = table[pieceOffsets[cells[44]] + 44];
+        if constexpr (operation == SUM_STORE)
+        {
+            values[44] = last;
+        }
+        if constexpr (operation == XOR)
+        {
+            return lanes[0] ^ lanes[1] ^ lanes[2] ^ lanes[3] ^ last;
+        }
+        else
+        {
+            return lanes[0] + lanes[1] + lanes[2] + lanes[3] + last;
+        }
+    }
+
+    // 8 cells per step, the last 5 cells use a masked gather and a masked store
+    template <Operation operation>
+    __attribute__((target("avx2,avx512f")))
+    int64_t _gatherAVX512(const int64_t *table, const uint8_t cells[45], int64_t *values)
+    {
+        __m512i accumulator = _mm512_setzero_si512();
+        __m256i cellIndices = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        for (size_t k = 0; k < 45; k += 8)
+        {
+            // Lanes past the last cell read the offset of an empty cell, but their values are masked out
+            __mmask8 mask = (k + 8 <= 45) ? 0xFF : (1U << (45 - k)) - 1;
+            int64_t word = 0;
+            std::memcpy(&word, cells + k, (k + 8 <= 45) ? 8 : 45 - k);
+            __m256i pieces = _mm256_cvtepu8_epi32(_mm_cvtsi64_si128(word));
+            __m256i offsets = _mm256_add_epi32(_mm256_i32gather_epi32(pieceOffsets.data(), pieces, 4), cellIndices);
+            __m512i gathered = _mm512_mask_i32gather_epi64(_mm512_setzero_si512(), mask, offsets, table, 8);
+            if constexpr (operation == XOR)
+            {
+                accumulator = _mm512_xor_si512(accumulator, gathered);
+            }
+            else
+            {
+                accumulator = _mm512_add_epi64(accumulator, gathered);
+            }
+            if constexpr (operation == SUM_STORE)
+            {
+                _mm512_mask_storeu_epi64(values + k, mask, gathered);
+            }
+            cellIndices = _mm256_add_epi32(cellIndices, _mm256_set1_epi32(8));
+        }
+
+        if constexpr (operation == XOR)
+        {
+            alignas(64) int64_t lanes[8];
+            _mm512_store_si512(lanes, accumulator);
+            return lanes[0] ^ lanes[1] ^ lanes[2] ^ lanes[3] ^ lanes[4] ^ lanes[5] ^ lanes[6] ^ lanes[7];
+        }
+        else
+        {
+            return _mm512_reduce_add_epi64(accumulator);
+        }
+    }
+
+    /* 16 inputs per step: maddubs multiplies the unsigned inputs by the signed weights and adds pairs into 16 bits,
+    then madd widens to 32 bits. Inputs are at most 127 so the 16-bit pairs cannot saturate. */
+    __attribute__((target("ssse3")))
+    void _affineSSSE3(const int8_t *weights, const uint8_t *inputs, size_t nInputs, size_t nOutputs, int32_t *outputs)
+    {
+        const __m128i ones = _mm_set1_epi16(1);
+        for (size_t output = 0; output < nOutputs; output++)
+        {
+            const int8_t *row = weights + output * nInputs;
+            __m128i accumulator = _mm_setzero_si128();
+            for (size_t input = 0; input < nInputs; input += 16)
+            {
+                __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(inputs + input));
+                __m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + input));
+                accumulator = _mm_add_epi32(accumulator, _mm_madd_epi16(_mm_maddubs_epi16(x, w), ones));
+            }
+            accumulator = _mm_add_epi32(accumulator, _mm_shuffle_epi32(accumulator, 0b01001110));
+            accumulator = _mm_add_epi32(accumulator, _mm_shuffle_epi32(accumulator, 0b10110001));
+            outputs[output] = _mm_cvtsi128_si32(accumulator);
+        }
+    }
+
+    // 16 inputs per step, the inputs are widened to 16 bits and madd multiplies them by the weights and adds pairs into 32 bits
+    __attribute__((target("sse2")))
+    void _affine16SSE2(const int16_t *weights, const uint8_t *inputs, size_t nInputs, size_t nOutputs, int32_t *outputs)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        for (size_t output = 0; output < nOutputs; output++)
+        {
+            const int16_t *row = weights + output * nInputs;
+            __m128i accumulator = _mm_setzero_si128();
+            for (size_t input = 0; input < nInputs; input += 16)
+            {
+                __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(inputs + input));
+                __m128i w0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + input));
+                __m128i w1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + input + 8));
+                accumulator = _mm_add_epi32(accumulator, _mm_madd_epi16(_mm_unpacklo_epi8(x, zero), w0));
+                accumulator = _mm_add_epi32(accumulator, _mm_madd_epi16(_mm_unpackhi_epi8(x, zero), w1));
+            }
+            accumulator = _mm_add_epi32(accumulator, _mm_shuffle_epi32(accumulator, 0b01001110));
+            accumulator = _mm_add_epi32(accumulator, _mm_shuffle_epi32(accumulator, 0b10110001));
+            outputs[output] = _mm_cvtsi128_si32(accumulator);
+        }
+    }
+
+    // Same as _affine16SSE2 with 32 inputs per step
+    __attribute__((target("avx2")))
+    void _affine16AVX2(const int16_t *weights, const uint8_t *inputs, size_t nInputs, size_t nOutputs, int32_t *outputs)
+    {
+        for (size_t output = 0; output < nOutputs; output++)
+        {
+            const int16_t *row = weights + output * nInputs;
+            __m256i accumulator = _mm256_setzero_si256();
+            for (size_t input = 0; input < nInputs; input += 32)
+            {
+                __m256i x0 = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(inputs + input)));
+                __m256i x1 = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(inputs + input + 16)));
+                __m256i w0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + input));
+                __m256i w1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + input + 16));
+                accumulator = _mm256_add_epi32(accumulator, _mm256_madd_epi16(x0, w0));
+                accumulator = _mm256_add_epi32(accumulator, _mm256_madd_epi16(x1, w1));
+            }
+            __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(accumulator), _mm256_extracti128_si256(accumulator, 1));
+            sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0b01001110));
+            sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0b10110001));
+            outputs[output] = _mm_cvtsi128_si32(sum);
+        }
+    }
+
+    // Same as _affineSSSE3 with 32 inputs per step
+    __attribute__((target("avx2")))
+    void _affineAVX2(const int8_t *weights, const uint8_t *inputs, size_t nInputs, size_t nOutputs, int32_t *outputs)
+    {
+        const __m256i ones = _mm256_set1_epi16(1);
+        for (size_t output = 0; output < nOutputs; output++)
+        {
+            const int8_t *row = weights + output * nInputs;
+            __m256i accumulator = _mm256_setzero_si256();
+            for (size_t input = 0; input < nInputs; input += 32)
+            {
+                __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(inputs + input));
+                __m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + input));
+                accumulator = _mm256_add_epi32(accumulator, _mm256_madd_epi16(_mm256_maddubs_epi16(x, w), ones));
+            }
+            __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(accumulator), _mm256_extracti128_si256(accumulator, 1));
+            sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0b01001110));
+            sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0b10110001));
+            outputs[output] = _mm_cvtsi128_si32(sum);
+        }
+    }
+
+    // Horizontal sums of 4 accumulators of 8 int32, returned in the 4 lanes of the result
+    __attribute__((target("avx2")))
+    inline __m128i _sum4AVX2(__m256i a0, __m256i a1, __m256i a2, __m256i a3)
+    {
+        __m256i sum = _mm256_hadd_epi32(_mm256_hadd_epi32(a0, a1), _mm256_hadd_epi32(a2, a3));
+        return _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    }
+
+    // Batched _affineAVX2, each chunk of 32 weights is multiplied by SIMD_BATCH_TILE input vectors
+    __attribute__((target("avx2")))
+    void _affineBatchAVX2(const int8_t *weights, const uint8_t *inputs, size_t nInputs, size_t nOutputs, size_t nBatch, int32_t *outputs)
+    {
+        static_assert(SIMD_BATCH_TILE == 4);
+        const __m256i ones = _mm256_set1_epi16(1);
+        size_t b = 0;
+        for (; b + SIMD_BATCH_TILE <= nBatch; b += SIMD_BATCH_TILE)
+        {
+            const uint8_t *x0 = inputs + b * nInputs;
+            const uint8_t *x1 = x0 + nInputs;
+            const uint8_t *x2 = x1 + nInputs;
+            const uint8_t *x3 = x2 + nInputs;
+            for (size_t output = 0; output < nOutputs; output++)
+            {
+                const int8_t *row = weights + output * nInputs;
+                __m256i a0 = _mm256_setzero_si256();
+                __m256i a1 = _mm256_setzero_si256();
+                __m256i a2 = _mm256_setzero_si256();
+                __m256i a3 = _mm256_setzero_si256();
+                for (size_t input = 0; input < nInputs; input += 32)
+                {
+                    __m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + input));
+                    a0 = _mm256_add_epi32(a0, _mm256_madd_epi16(_mm256_maddubs_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(x0 + input)), w), ones));
+                    a1 = _mm256_add_epi32(a1, _mm256_madd_epi16(_mm256_maddubs_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(x1 + input)), w), ones));
+                    a2 = _mm256_add_epi32(a2, _mm256_madd_epi16(_mm256_maddubs_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(x2 + input)), w), ones));
+                    a3 = _mm256_add_epi32(a3, _mm256_madd_epi16(_mm256_maddubs_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(x3 + input)), w), ones));
+                }
+                alignas(16) int32_t sums[4];
+                _mm_store_si128(reinterpret_cast<__m128i *>(sums), _sum4AVX2(a0, a1, a2, a3));
+                for (size_t k = 0; k < SIMD_BATCH_TILE; k++)
+                {
+                    outputs[(b + k) * nOutputs + output] = sums[k];
+                }
+            }
+        }
+        _affineBatchRows<int8_t, _affineAVX2>(weights, inputs + b * nInputs, nInputs, nOutputs, nBatch - b, outputs + b * nOutputs);
+    }
+
+    // Batched _affine16AVX2, the input vectors are widened once per chunk of 16 and each chunk of weights is used for SIMD_BATCH_TILE of them
+    __attribute__((target("avx2")))
+    void _affine16BatchAVX2(const int16_t *weights, const uint8_t *inputs, size_t nInputs, size_t nOutputs, size_t nBatch, int32_t *outputs)
+    {
+        static_assert(SIMD_BATCH_TILE == 4);
+        size_t b = 0;
+        for (; b + SIMD_BATCH_TILE <= nBatch; b += SIMD_BATCH_TILE)
+        {
+            const uint8_t *x0 = inputs + b * nInputs;
+            const uint8_t *x1 = x0 + nInputs;
+            const uint8_t *x2 = x1 + nInputs;
+            const uint8_t *x3 = x2 + nInputs;
+            for (size_t output = 0; output < nOutputs; output++)
+            {
+                const int16_t *row = weights + output * nInputs;
+                __m256i a0 = _mm256_setzero_si256();
+                __m256i a1 = _mm256_setzero_si256();
+                __m256i a2 = _mm256_setzero_si256();
+                __m256i a3 = _mm256_setzero_si256();
+                for (size_t input = 0; input < nInputs; input += 16)
+                {
+                    __m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + input));
+                    a0 = _mm256_add_epi32(a0, _mm256_madd_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(x0 + input))), w));
+                    a1 = _mm256_add_epi32(a1, _mm256_madd_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(x1 + input))), w));
+                    a2 = _mm256_add_epi32(a2, _mm256_madd_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(x2 + input))), w));
+                    a3 = _mm256_add_epi32(a3, _mm256_madd_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(x3 + input))), w));
+                }
+                alignas(16) int32_t sums[4];
+                _mm_store_si128(reinterpret_cast<__m128i *>(sums), _sum4AVX2(a0, a1, a2, a3));
+                for (size_t k = 0; k < SIMD_BATCH_TILE; k++)
+                {
+                    outputs[(b + k) * nOutputs + output] = sums[k];
+                }
+            }
+        }
+        _affineBatchRows<int16_t, _affine16AVX2>(weights, inputs + b * nInputs, nInputs, nOutputs, nBatch - b, outputs + b * nOutputs);
+    }
+#endif
+
+    struct Kernels
+    {
+        int64_t (*sum)(const int64_t *, const uint8_t *, int64_t *);
+        int64_t (*sumStore)(const int64_t *, const uint8_t *, int64_t *);
+        int64_t (*xorAll)(const int64_t *, const uint8_t *, int64_t *);
+        void (*affine)(const int8_t *, const uint8_t *, size_t, size_t, int32_t *);
+        void (*affine16)(const int16_t *, const uint8_t *, size_t, size_t, int32_t *);
+        void (*affineBatch)(const int8_t *, const uint8_t *, size_t, size_t, size_t, int32_t *);
+        void (*affine16Batch)(const int16_t *, const uint8_t *, size_t, size_t, size_t, int32_t *);
+        const char *name;
+    };
+
+    // Picks the widest kernel supported by the CPU
+    Kernels _selectKernels()
+    {
+#ifdef SIMD_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx2"))
+        {
+            return {_gatherAVX512<SUM>, _gatherAVX512<SUM_STORE>, _gatherAVX512<XOR>, _affineAVX2, _affine16AVX2, _affineBatchAVX2, _affine16BatchAVX2, "avx512"};
+        }
+        if (__builtin_cpu_supports("avx2"))
+        {
+            return {_gatherAVX2<SUM>, _gatherAVX2<SUM_STORE>, _gatherAVX2<XOR>, _affineAVX2, _affine16AVX2, _affineBatchAVX2, _affine16BatchAVX2, "avx2"};
+        }
+        if (__builtin_cpu_supports("ssse3"))
+        {
+            return {_gatherScalar<SUM>, _gatherScalar<SUM_STORE>, _gatherScalar<XOR>, _affineSSSE3, _affine16SSE2, _affineBatchRows<int8_t, _affineSSSE3>, _affineBatchRows<int16_t, _affine16SSE2>, "ssse3"};
+        }
+#endif
+        return {_gatherScalar<SUM>, _gatherScalar<SUM_STORE>, _gatherScalar<XOR>, _affineScalar<int8_t>, _affineScalar<int16_t>, _affineBatchRows<int8_t, _affineScalar<int8_t>>, _affineBatchRows<int16_t, _affineScalar<int16_t>>, "scalar"};
+    }
+
+    const Kernels kernels = _selectKernels();
+
+    // Returns the sum of the table values of all the cells
+    int64_t gatherSum(const int64_t table[1575], const uint8_t cells[45])
+    {
+        return kernels.sum(table, cells, nullptr);
+    }
+
+    // Returns the sum of the table values of all the cells, saves the individual values
+    int64_t gatherSum(const int64_t table[1575], const uint8_t cells[45], int64_t values[45])
+    {
+        return kernels.sumStore(table, cells, values);
+    }
+
+    // Returns the xor of the table values of all the cells
+    uint64_t gatherXor(const uint64_t table[1575], const uint8_t cells[45])
+    {
+        return kernels.xorAll(reinterpret_cast<const int64_t *>(table), cells, nullptr);
+    }
+
+    // Computes an integer dense layer
+    void affine(const int8_t *weights, const uint8_t *inputs, size_t nInputs, size_t nOutputs, int32_t *outputs)
+    {
+        kernels.affine(weights, inputs, nInputs, nOutputs, outputs);
+    }
+
+    // Computes an integer dense layer with int16 weights
+    void affine16(const int16_t *weights, const uint8_t *inputs, size_t nInputs, size_t nOutputs, int32_t *outputs)
+    {
+        kernels.affine16(weights, inputs, nInputs, nOutputs, outputs);
+    }
+
+    // Computes an integer dense layer over a batch of input vectors
+    void affineBatch(const int8_t *weights, const uint8_t *inputs, size_t nInputs, size_t nOutputs, size_t nBatch, int32_t *outputs)
+    {
+        kernels.affineBatch(weights, inputs, nInputs, nOutputs, nBatch, outputs);
+    }
+
+    // Computes an integer dense layer with int16 weights over a batch of input vectors
+    void affine16Batch(const int16_t *weights, const uint8_t *inputs, size_t nInputs, size_t nOutputs, size_t nBatch, int32_t *outputs)
+    {
+        kernels.affine16Batch(weights, inputs, nInputs, nOutputs, nBatch, outputs);
+    }
+
+    // Returns the name of the kernel in use
+    std::string instructionSet()
+    {
+        return kernels.name;
+    }
+}
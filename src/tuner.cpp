@@ -0,0 +1,275 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <omp.h>
+
+#include <evaluation.hpp>
+#include <logic.hpp>
+#include <lookup.hpp>
+#include <utils.hpp>
+
+using namespace PijersiEngine;
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+using namespace std::chrono;
+
+/* Texel tuning of the evaluation parameters.
+The table evaluation is linear in the parameters, so a position is reduced to the sum of the coefficients of each parameter over its cells.
+The loss is the mean squared error between the game result and sigmoid(K * evaluation), K is fitted first with the starting parameters.
+The parameters are then optimised by Adam on the exact gradient, each pass over the dataset runs in parallel. */
+
+// The goal line score only appears in won positions, it is not tuned
+const bool tunedParameters[N_EVAL_PARAMETERS] = {true, true, true, true, true, true, false, true, true};
+
+struct Dataset
+{
+    // coefficients[position * N_EVAL_PARAMETERS + parameter]
+    vector<float> coefficients;
+    // Result for White: 1 win, 0.5 draw, 0 loss
+    vector<float> results;
+
+    size_t size() const
+    {
+        return results.size();
+    }
+};
+
+// Reads a result written as 1, 0.5, 0, 1-0, 1/2-1/2 or 0-1, returns false if it is not one of them
+bool parseResult(const string &word, float &result)
+{
+    if (word == "1-0")
+    {
+        result = 1.f;
+    }
+    else if (word == "0-1")
+    {
+        result = 0.f;
+    }
+    else if (word == "1/2-1/2")
+    {
+        result = 0.5f;
+    }
+    else
+    {
+        try
+        {
+            result = std::stof(word);
+        }
+        catch (const std::exception &)
+        {
+            return false;
+        }
+    }
+    return result >= 0.f && result <= 1.f;
+}
+
+/* Loads a dataset with one position per line: the 4 words of the PSN then the result for White.
+Invalid lines are skipped. */
+Dataset loadDataset(const string &fileName)
+{
+    // Coefficients of each parameter for each (piece, cell), from unit parameter vectors
+    vector<float> unitScores(N_EVAL_PARAMETERS * 1575, 0.f);
+    for (size_t parameter = 0; parameter < N_EVAL_PARAMETERS; parameter++)
+    {
+        Evaluation::Parameters unit;
+        std::fill(unit.values, unit.values + N_EVAL_PARAMETERS, 0.f);
+        unit.values[parameter] = 1.f;
+        for (size_t piece = 0; piece < 256; piece++)
+        {
+            size_t pieceIndex = Lookup::pieceToIndex[piece];
+            if (pieceIndex == 34)
+            {
+                continue;
+            }
+            for (size_t index = 0; index < 45; index++)
+            {
+                unitScores[parameter * 1575 + pieceIndex * 45 + index] = unit.pieceScore(piece, index);
+            }
+        }
+    }
+
+    Dataset dataset;
+    std::ifstream file(fileName);
+    string line;
+    size_t nSkipped = 0;
+    while (std::getline(file, line))
+    {
+        vector<string> words = Utils::split(Utils::strip(line), " ");
+        float result;
+        if (words.size() < 5 || !parseResult(words[4], result))
+        {
+            nSkipped++;
+            continue;
+        }
+        uint8_t cells[45];
+        try
+        {
+            Logic::stringToCells(words[0], cells);
+        }
+        catch (const std::exception &)
+        {
+            nSkipped++;
+            continue;
+        }
+        for (size_t parameter = 0; parameter < N_EVAL_PARAMETERS; parameter++)
+        {
+            float coefficient = 0.f;
+            for (size_t index = 0; index < 45; index++)
+            {
+                coefficient += unitScores[parameter * 1575 + Lookup::pieceToIndex[cells[index]] * 45 + index];
+            }
+            dataset.coefficients.push_back(coefficient);
+        }
+        dataset.results.push_back(result);
+    }
+    if (nSkipped > 0)
+    {
+        cout << "Skipped " << nSkipped << " invalid lines" << endl;
+    }
+    return dataset;
+}
+
+inline float sigmoid(float x)
+{
+    return 1.f / (1.f + std::exp(-x));
+}
+
+// Returns the loss, adds its gradient with respect to the parameters to gradient if it is not null
+double loss(const Dataset &dataset, const float values[N_EVAL_PARAMETERS], float k, double gradient[N_EVAL_PARAMETERS])
+{
+    double totalLoss = 0.;
+    double totalGradient[N_EVAL_PARAMETERS] = {};
+    size_t nPositions = dataset.size();
+
+    #pragma omp parallel for schedule(static) reduction(+ : totalLoss, totalGradient[:N_EVAL_PARAMETERS])
+    for (size_t position = 0; position < nPositions; position++)
+    {
+        const float *coefficients = dataset.coefficients.data() + position * N_EVAL_PARAMETERS;
+        float evaluation = 0.f;
+        for (size_t parameter = 0; parameter < N_EVAL_PARAMETERS; parameter++)
+        {
+            evaluation += coefficients[parameter] * values[parameter];
+        }
+        float prediction = sigmoid(k * evaluation);
+        float error = prediction - dataset.results[position];
+        totalLoss += error * error;
+        if (gradient != nullptr)
+        {
+            float factor = 2.f * error * prediction * (1.f - prediction) * k;
+            for (size_t parameter = 0; parameter < N_EVAL_PARAMETERS; parameter++)
+            {
+                totalGradient[parameter] += factor * coefficients[parameter];
+            }
+        }
+    }
+
+    if (gradient != nullptr)
+    {
+        for (size_t parameter = 0; parameter < N_EVAL_PARAMETERS; parameter++)
+        {
+            gradient[parameter] = totalGradient[parameter] / nPositions;
+        }
+    }
+    return totalLoss / nPositions;
+}
+
+// Golden section search of the K that minimises the loss, on a logarithmic scale
+float fitK(const Dataset &dataset, const float values[N_EVAL_PARAMETERS])
+{
+    const double ratio = (std::sqrt(5.) - 1.) / 2.;
+    double low = std::log(1e-6);
+    double high = std::log(1e-1);
+    for (size_t iteration = 0; iteration < 40; iteration++)
+    {
+        double left = high - ratio * (high - low);
+        double right = low + ratio * (high - low);
+        if (loss(dataset, values, std::exp(left), nullptr) < loss(dataset, values, std::exp(right), nullptr))
+        {
+            high = right;
+        }
+        else
+        {
+            low = left;
+        }
+    }
+    return std::exp((low + high) / 2.);
+}
+
+int main(int argc, char **argv)
+{
+    // tuner [dataset] [output table file] [iterations] [learning rate]
+    if (argc < 2)
+    {
+        cout << "Usage: tuner [dataset] [output table file] [iterations] [learning rate]" << endl;
+        return EXIT_FAILURE;
+    }
+    string datasetFileName = argv[1];
+    string outputFileName = (argc >= 3) ? argv[2] : "pieceScores.txt";
+    size_t nIterations = (argc >= 4) ? std::stoul(argv[3]) : 500;
+    double learningRate = (argc >= 5) ? std::stod(argv[4]) : 1.;
+
+    auto start = steady_clock::now();
+    Dataset dataset = loadDataset(datasetFileName);
+    if (dataset.size() == 0)
+    {
+        cout << "Empty dataset" << endl;
+        return EXIT_FAILURE;
+    }
+    cout << "Loaded " << dataset.size() << " positions in " << duration_cast<milliseconds>(steady_clock::now() - start).count() << " ms" << endl;
+
+    Evaluation::Parameters parameters;
+    float k = fitK(dataset, parameters.values);
+    cout << "K: " << k << endl;
+    cout << "Initial loss: " << loss(dataset, parameters.values, k, nullptr) << endl;
+
+    // Adam
+    const double beta1 = 0.9;
+    const double beta2 = 0.999;
+    double moment1[N_EVAL_PARAMETERS] = {};
+    double moment2[N_EVAL_PARAMETERS] = {};
+    start = steady_clock::now();
+    for (size_t iteration = 1; iteration <= nIterations; iteration++)
+    {
+        double gradient[N_EVAL_PARAMETERS];
+        double currentLoss = loss(dataset, parameters.values, k, gradient);
+        for (size_t parameter = 0; parameter < N_EVAL_PARAMETERS; parameter++)
+        {
+            if (!tunedParameters[parameter])
+            {
+                continue;
+            }
+            moment1[parameter] = beta1 * moment1[parameter] + (1. - beta1) * gradient[parameter];
+            moment2[parameter] = beta2 * moment2[parameter] + (1. - beta2) * gradient[parameter] * gradient[parameter];
+            double corrected1 = moment1[parameter] / (1. - std::pow(beta1, iteration));
+            double corrected2 = moment2[parameter] / (1. - std::pow(beta2, iteration));
+            parameters.values[parameter] -= learningRate * corrected1 / (std::sqrt(corrected2) + 1e-12);
+        }
+        if (iteration % 50 == 0 || iteration == nIterations)
+        {
+            cout << "Iteration " << iteration << " loss " << currentLoss << " parameters " << parameters.toString() << endl;
+        }
+    }
+    double duration = duration_cast<milliseconds>(steady_clock::now() - start).count();
+    cout << "Final loss: " << loss(dataset, parameters.values, k, nullptr) << endl;
+    cout << "Time per pass: " << duration / nIterations << " ms" << endl;
+    cout << "Parameters: " << parameters.toString() << endl;
+
+    int64_t table[1575];
+    parameters.fillTable(table);
+    if (!Evaluation::saveTable(outputFileName, table))
+    {
+        cout << "Could not write " << outputFileName << endl;
+        return EXIT_FAILURE;
+    }
+    cout << "Table written to " << outputFileName << endl;
+    return EXIT_SUCCESS;
+}
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cstdlib>
 #include <iostream>
 #include <string>
@@ -7,7 +8,12 @@
 
 #include <board.hpp>
 #include <alphabeta.hpp>
+#include <benchmark.hpp>
+#include <evaluation.hpp>
+#include <hash.hpp>
 #include <logic.hpp>
+#include <mcts.hpp>
+#include <nnue.hpp>
 #include <options.hpp>
 #include <utils.hpp>
 
@@ -44,6 +50,7 @@ int main(int argc, char** argv)
             else if (command == "uginewgame")
             {
                 board.init();
+                MCTS::tree.clear();
             }
             else if (command == "ugi")
             {
@@ -52,6 +59,17 @@ int main(int argc, char** argv)
                 cout << "option name threads type spin default 8" << endl;
                 cout << "option name verbose type check default true" << endl;
                 cout << "option name openingBook type check default true" << endl;
+                cout << "option name nnue type check default false" << endl;
+                cout << "option name evalFile type string default <empty>" << endl;
+                cout << "option name evalCacheSize type spin default 4" << endl;
+                cout << "option name evalParamFile type string default <empty>" << endl;
+                cout << "option name evalParams type string default <empty>" << endl;
+                cout << "option name engine type combo default alphabeta var alphabeta var mcts" << endl;
+                cout << "option name mctsPUCT type check default false" << endl;
+                cout << "option name mctsRAVE type check default false" << endl;
+                cout << "option name mctsBatchSize type spin default 32" << endl;
+                cout << "option name mctsMaxNodes type spin default 8388608" << endl;
+                cout << "option name mctsRolloutPlies type spin default 64" << endl;
                 cout << "ugiok" << endl;
             }
             else if (command == "setoption")
@@ -74,6 +92,123 @@ int main(int argc, char** argv)
                         string value = words[4];
                         Options::openingBook = (value == "true");
                     }
+                    if (parameter == "nnue")
+                    {
+                        string value = words[4];
+                        Options::nnue = (value == "true");
+                        if (Options::nnue && !NNUE::ensureLoaded())
+                        {
+                            cout << "info string could not load the network, the table evaluation is used" << endl;
+                        }
+                    }
+                    if (parameter == "evalCacheSize")
+                    {
+                        string value = words[4];
+                        Options::evalCacheSize = std::max(stoi(value), 0);
+                    }
+                    if (parameter == "evalParamFile")
+                    {
+                        string value = words[4];
+                        for (size_t k = 5; k < words.size(); k++)
+                        {
+                            value += " " + words[k];
+                        }
+                        if (value == "<empty>")
+                        {
+                            Evaluation::resetTable();
+                            Options::evalParamFile = "";
+                        }
+                        else if (Evaluation::loadFile(value))
+                        {
+                            Options::evalParamFile = value;
+                        }
+                        else
+                        {
+                            cout << "info string could not load evalParamFile " << value << endl;
+                        }
+                    }
+                    if (parameter == "evalParams")
+                    {
+                        // The parameters are separate words
+                        string value = words[4];
+                        for (size_t k = 5; k < words.size(); k++)
+                        {
+                            value += " " + words[k];
+                        }
+                        Evaluation::Parameters parameters;
+                        if (value == "<empty>")
+                        {
+                            Evaluation::resetTable();
+                        }
+                        else if (parameters.parse(value))
+                        {
+                            Evaluation::setParameters(parameters);
+                        }
+                        else
+                        {
+                            cout << "info string evalParams needs " << N_EVAL_PARAMETERS << " numbers" << endl;
+                        }
+                    }
+                    if (parameter == "engine")
+                    {
+                        string value = words[4];
+                        if (value == "alphabeta" || value == "mcts")
+                        {
+                            Options::engine = value;
+                        }
+                        else
+                        {
+                            cout << "info string unknown engine " << value << endl;
+                        }
+                    }
+                    if (parameter == "mctsPUCT")
+                    {
+                        string value = words[4];
+                        Options::mctsPUCT = (value == "true");
+                    }
+                    if (parameter == "mctsRAVE")
+                    {
+                        string value = words[4];
+                        Options::mctsRAVE = (value == "true");
+                    }
+                    if (parameter == "mctsBatchSize")
+                    {
+                        string value = words[4];
+                        Options::mctsBatchSize = std::max(stoi(value), 1);
+                    }
+                    if (parameter == "mctsMaxNodes")
+                    {
+                        string value = words[4];
+                        Options::mctsMaxNodes = std::max(stoll(value), 0LL);
+                    }
+                    if (parameter == "mctsRolloutPlies")
+                    {
+                        string value = words[4];
+                        Options::mctsRolloutPlies = std::max(stoi(value), 0);
+                    }
+                    if (parameter == "evalFile")
+                    {
+                        // The file name can contain spaces
+                        string value = words[4];
+                        for (size_t k = 5; k < words.size(); k++)
+                        {
+                            value += " " + words[k];
+                        }
+                        if (value == "<empty>")
+                        {
+                            value = "";
+                        }
+                        if (NNUE::network.load(value))
+                        {
+                            Options::evalFile = value;
+                            // The cached scores are those of the previous network
+                            Hash::evalCache.clear();
+                        }
+                        else
+                        {
+                            cout << "info string could not load evalFile " << value << endl;
+                        }
+                    }
                 }
             }
             else if (command == "isready")
@@ -89,8 +224,13 @@ int main(int argc, char** argv)
                     string parameter = words[2];
                     if (mode == "depth")
                     {
+                        // The MCTS search has no depth limit
                         int depth = stoi(parameter);
-                        if (depth >= 1)
+                        if (Options::engine == "mcts")
+                        {
+                            cout << "info string go depth needs the alphabeta engine" << endl;
+                        }
+                        else if (depth >= 1)
                         {
                             uint64_t move = board.searchDepth(depth, true);
                             if (move != NULL_MOVE)
@@ -110,7 +250,30 @@ int main(int argc, char** argv)
                         int durationMilliseconds = stoi(parameter);
                         if (durationMilliseconds >= 0)
                         {
-                            uint64_t move = board.searchTime(true, durationMilliseconds);
+                            uint64_t move = (Options::engine == "mcts") ? board.searchMCTS(durationMilliseconds) : board.searchTime(true, durationMilliseconds);
+                            if (move != NULL_MOVE)
+                            {
+                                string moveString = Logic::moveToString(move, board.cells);
+                                cout << "bestmove " << moveString << endl;
+                                board.playManual(move);
+                            }
+                            else
+                            {
+                                cout << "wtf" << endl;
+                            }
+                        }
+                    }
+                    else if (mode == "nodes")
+                    {
+                        // Visits of the MCTS root, the alphabeta search has no node limit
+                        if (Options::engine != "mcts")
+                        {
+                            cout << "info string go nodes needs the mcts engine" << endl;
+                        }
+                        else
+                        {
+                            uint64_t nodes = stoull(parameter);
+                            uint64_t move = board.searchMCTS(UINT64_MAX, nodes);
                             if (move != NULL_MOVE)
                             {
                                 string moveString = Logic::moveToString(move, board.cells);
@@ -129,6 +292,15 @@ int main(int argc, char** argv)
                     }
                 }
             }
+            else if (command == "bench")
+            {
+                int searchDepth = BENCH_SEARCH_DEPTH;
+                if (words.size() >= 2)
+                {
+                    searchDepth = stoi(words[1]);
+                }
+                Benchmark::run(BENCH_PERFT_DEPTH, searchDepth);
+            }
             else if (command == "position")
             {
                 if (words.size() >= 2)
@@ -9,13 +9,10 @@
 #include <string>
 #include <vector>
 
-#include "Eigen/Dense"
-#include "Eigen/Sparse"
-
 #include "alphabeta.hpp"
 #include "board.hpp"
-#include "nn.hpp"
-#include "lookup.hpp"
+#include "evaluation.hpp"
+#include "options.hpp"
 
 using namespace PijersiEngine;
 using std::cout;
@@ -27,7 +24,8 @@ using namespace std::chrono;
 
 // Score line 1 to 7, stack bonus, wise fixed score
 float scoresCurrent[7 + 1 + 1] = {63.6369, 98.5258, 111.57, 112.084, 133.013, 132.617, 150, -10.9016, 68.3554};
-float scoresEval[2][7 + 1 + 1] = {{90, 100, 110, 120, 130, 140, 150, 30, 80}, {63.6369, 98.5258, 111.57, 112.084, 133.013, 132.617, 150, -10.9016, 68.3554}};
+// Parameters of each engine, engine 1 is the reference and engine 2 the candidate
+Evaluation::Parameters scoresEval[2] = {{{90, 100, 110, 120, 130, 140, 150, 30, 80}}, {{63.6369, 98.5258, 111.57, 112.084, 133.013, 132.617, 150, -10.9016, 68.3554}}};
 // {71.6253, 92.3781, 99.3675, 117.182, 137.446, 168.55, 150, -14.4487, 80}
 // {94.1396 95.0996 110 124.838 130 140 150 10 75.6163}
 // {63.6804 100 111.324 119.4 130 143.845 150 -16.2713 62.5864} -> 0.2076
@@ -51,83 +49,15 @@ vector<string> readFile(string fileName)
     return lines;
 }
 
-void fillTable()
-{
-    for (size_t side = 0; side < 2; side++)
-    {
-        for (size_t piece = 0; piece < 256; piece++)
-        {
-            for (size_t index = 0; index < 45; index++)
-            {
-                if (Lookup::pieceToIndex[piece] != 34)
-                {
-                    float score = 0;
-                    if ((piece & 12) != 12)
-                    {
-                        if ((piece & 2) == 0)
-                        {
-                            score = scoresEval[side][6 - Logic::indexToLine[index]];
-                        }
-                        else
-                        {
-                            score = -scoresEval[side][Logic::indexToLine[index]];
-                        }
-                        if (((piece & 2) == 0 && Logic::indexToLine[index] == 0) || ((piece & 2) == 2 && Logic::indexToLine[index] == 6))
-                        {
-                            score *= 256;
-                        }
-                        if (piece > 16)
-                        {
-                            score *= 2;
-                            if ((piece & 2) == 0)
-                            {
-                                score += scoresEval[side][7];
-                            }
-                            else
-                            {
-                                score -= scoresEval[side][7];
-                            }
-                        }
-                    }
-                    else
-                    {
-                        if ((piece & 2) == 0)
-                        {
-                            score = scoresEval[side][8];
-                        }
-                        else
-                        {
-                            score = -scoresEval[side][8];
-                        }
-                        if (piece > 16)
-                        {
-                            score *= 2;
-                            if ((piece & 2) == 0)
-                            {
-                                score += scoresEval[side][7];
-                            }
-                            else
-                            {
-                                score -= scoresEval[side][7];
-                            }
-                        }
-                    }
-                    Lookup::pieceScores[1575 * side + Lookup::pieceToIndex[piece] * 45 + index] = score;
-                }
-            }
-        }
-    }
-}
-
 void mutate(size_t selectedParameter, float delta)
 {
-    scoresEval[1][selectedParameter] += delta;
+    scoresEval[1].values[selectedParameter] += delta;
 
     cout << "Parameter: " << selectedParameter << "   Delta: " << delta << endl;
     cout << "Original: ";
     for (size_t k = 0; k < 9; k++)
     {
-        cout << scoresEval[0][k] << " ";
+        cout << scoresEval[0].values[k] << " ";
     }
     cout << endl;
     cout << "Current:  ";
@@ -139,7 +69,7 @@ void mutate(size_t selectedParameter, float delta)
     cout << "New:      ";
     for (size_t k = 0; k < 9; k++)
     {
-        cout << scoresEval[1][k] << " ";
+        cout << scoresEval[1].values[k] << " ";
     }
     cout << endl;
 }
@@ -152,44 +82,64 @@ void update(bool keep, size_t selectedParameter, float delta, float learningRate
     }
     for (size_t k = 0; k < 9; k++)
     {
-        scoresEval[1][k] = scoresCurrent[k];
+        scoresEval[1].values[k] = scoresCurrent[k];
     }
 }
 
-float playGames(Board board, size_t nRepeats, vector<string> openings)
+/* Plays the games between the two engines, each game runs single-threaded on its own board so that the games run concurrently on all cores.
+Each pair of games uses the same opening with the starting engine swapped. */
+float playGames(size_t nRepeats, const vector<string> &openings)
 {
-    size_t side = 0;
-    size_t starting_player = 0;
     uint64_t winCount[2] = {0, 0};
 
     int depth = 3;
 
     size_t nGames = openings.size() * nRepeats * 2;
+    size_t nFinishedGames = 0;
+
+    // Tables of the two engines, read by all the threads
+    int64_t tables[2][1575];
+    scoresEval[0].fillTable(tables[0]);
+    scoresEval[1].fillTable(tables[1]);
 
+    // The games are the parallel tasks, their searches must not start more threads
+    Options::threads = 1;
+
+    #pragma omp parallel for schedule(dynamic)
     for (size_t iter = 0; iter < nGames; iter++)
     {
-        if (iter % (nGames / 20) == 0)
-        {
-            cout << "Starting game " << iter << "/" << nGames << '\r' << flush;
-        }
+        Board board;
         board.init();
-        board.setStringState(openings[(iter/2)%openings.size()]);
-        // board.playRandom();
-        side = starting_player;
+        board.setStringState(openings[(iter / 2) % openings.size()]);
+        size_t side = iter % 2;
         while (!board.checkWin() && !board.checkDraw() && !board.checkStalemate())
         {
-            board.playDepth(depth, true, side);
+            // Each engine searches with its own table
+            Evaluation::setThreadTable(tables[side]);
+            board.playDepth(depth, true);
             if (board.checkWin() || board.checkStalemate())
             {
-                winCount[side] += 1;
+                #pragma omp atomic
+                winCount[side]++;
                 if (board.checkStalemate())
                 {
+                    #pragma omp critical
                     cout << "Stalemate" << endl;
                 }
             }
             side = 1 - side;
         }
-        starting_player = 1 - starting_player;
+        // The tables don't outlive this function
+        Evaluation::setThreadTable(nullptr);
+
+        size_t finishedGames;
+        #pragma omp atomic capture
+        finishedGames = ++nFinishedGames;
+        if (finishedGames % std::max<size_t>(nGames / 20, 1) == 0)
+        {
+            #pragma omp critical
+            cout << "Finished game " << finishedGames << "/" << nGames << '\r' << flush;
+        }
     }
 
     float winRate[2] = {0, 0};
@@ -209,8 +159,8 @@ float playGames(Board board, size_t nRepeats, vector<string> openings)
 
 int main(int argc, char **argv)
 {
-    Board board;
-    board.init();
+    Options::verbose = false;
+    Options::openingBook = false;
 
     vector<string> openings = readFile("ply1.txt");
 
@@ -221,12 +171,11 @@ int main(int argc, char **argv)
 
     bool keep = false;
 
-    fillTable();
     cout << "Initial comparison" << endl;
     cout << "Original: ";
     for (size_t k = 0; k < 9; k++)
     {
-        cout << scoresEval[0][k] << " ";
+        cout << scoresEval[0].values[k] << " ";
     }
     cout << endl;
     cout << "Current:  ";
@@ -235,7 +184,7 @@ int main(int argc, char **argv)
         cout << scoresCurrent[k] << " ";
     }
     cout << endl;
-    float bestWinRateDelta = playGames(board, repeatsPerIter, openings);
+    float bestWinRateDelta = playGames(repeatsPerIter, openings);
     cout << "Initial W/R delta: " << bestWinRateDelta << endl;
 
 
@@ -251,9 +200,8 @@ int main(int argc, char **argv)
         float delta = deltaDistribution(gen);
 
         mutate(selectedParameter, delta);
-        fillTable();
 
-        float winRateDelta = playGames(board, repeatsPerIter, openings);
+        float winRateDelta = playGames(repeatsPerIter, openings);
         cout << "New W/R delta: " << winRateDelta << " | Current W/R Delta: " << bestWinRateDelta << " | Difference: " << winRateDelta - bestWinRateDelta << endl;
 
         if (winRateDelta > bestWinRateDelta)